@@ -6,6 +6,7 @@
 #endif
 
 #include "DocDetector.hpp"
+#include "../src/LinesQuads.hpp"
 
 #include <opencv2/imgproc.hpp>
 
@@ -54,8 +55,10 @@ extern "C" int __declspec(dllexport) __stdcall DocumentDetection(uint width, uin
 	if (errCode != NO_ERRORS) return errCode;
 	errCode = SegmentsDetector(edgeDetect, lines);
 	if (errCode != NO_ERRORS) return errCode;
+	*outDocumentsCount = 0;
 	errCode = LinesToDocs(lines, docs);
 	if (errCode != NO_ERRORS) return errCode;
+	*outDocumentsCount = MIN(maxDocumentsCount, uint(docs.size()));
 
 	// Unity already pre allocated the memory of outDocumentCorners to be maxDocumentCount * 8 * sizeof(int)
 	errCode = DocsToUnity(docs, outDocumentsCorners, maxDocumentsCount, *outDocumentsCount);
@@ -205,19 +208,15 @@ int LinesDetector(const Mat& src, vector<Vec4i>& lines,
 	return NO_ERRORS;
 }
 
-int LinesToDocs(const vector<Vec4i>& lines, vector<Vec8i>& docs)
+int LinesToDocs(const vector<Vec4i>& lines, vector<Vec8i>& docs,
+	const double angleTresh, const double distTresh, const double perpendicularTresh,
+	const double minCoverage, const double maxExtension)
 {
+	docs.clear();
 	if (lines.empty())	return NO_LINES;
-	// Temporary line to have something to get inside Unity
-	docs.emplace_back(0, 0, 100, 0, 0, 100, 100, 100);
-
-	// Step 1 Merging of the collinear segments
-	// Step 2 Transformation of segments into lines 
-	//			(to create intersections especially on segments not going to the corners of documents)
-	// Step 3 Locate the perpendicular intersection (with a threshold)
-	// Step 4 find a document satisfying the following conditions: 4 lines forming a rectangle 
-	//			(4 perpendicular corners and adjacent side not necessarily of the same size)
-	return NO_ERRORS;
+	// Steps 1 to 4 (merging, lines, perpendicular intersections, cycles of 4 lines) in LinesQuads
+	LinesToQuads(lines, docs, angleTresh, distTresh, perpendicularTresh, minCoverage, maxExtension);
+	return docs.empty() ? NO_DOCS : NO_ERRORS;
 }
 
 //******************************
@@ -110,12 +110,22 @@ int LinesDetector(const cv::Mat &src, std::vector<cv::Vec4i> &lines,
 
 /// <summary>
 /// Lines to docs detection.
+/// The collinear segments are merged into lines, the lines extended and intersected,
+/// and the documents are the cycles of 4 lines with 4 perpendicular corners.
+/// A side only needs to be partly covered by segments (document border partly occluded).
 /// </summary>
 /// <param name="lines">Vector of lines. Each line is represented by a 4-element vector \f$(x_1, y_1, x_2, y_2)\f$,
 /// where \f$(x_1,y_1)\f$ and \f$(x_2, y_2)\f$ are the ending points of each detected line segment.</param>
 /// <param name="docs">Vector of Documents. Each doc is represented by a 8-elements vector \f$(x_1, y_1, x_2, y_2, x_3, y_3, x_4, y_4)\f$,
 /// where \f$(x_1,y_1)\f$, \f$(x_2, y_2)\f$, \f$(x_3, y_3)\f$ and \f$(x_4, y_4)\f$ are the corner of each detected Document.</param>
-int LinesToDocs(const std::vector<cv::Vec4i> &lines, std::vector<cv::Vec8i> &docs);
+/// <param name="angleTresh">Maximum angle between two collinear segments (radians).</param>
+/// <param name="distTresh">Maximum distance between two collinear segments (pixels).</param>
+/// <param name="perpendicularTresh">Tolerance on the right angle of a corner and on parallel sides (radians).</param>
+/// <param name="minCoverage">Minimum ratio of each side covered by segments.</param>
+/// <param name="maxExtension">Extension of the lines on each side to find the corners (ratio of their length).</param>
+int LinesToDocs(const std::vector<cv::Vec4i> &lines, std::vector<cv::Vec8i> &docs,
+	double angleTresh = CV_PI / 90, double distTresh = 5, double perpendicularTresh = CV_PI / 18,
+	double minCoverage = 0.5, double maxExtension = 1.0);
 
 //******************************
 //********** Drawings **********
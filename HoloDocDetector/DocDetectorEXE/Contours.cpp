@@ -1,5 +1,6 @@
 #include "Contours.hpp"
 #include "Misc.hpp"
+#include "Kernels.hpp"
 #include <opencv2/imgproc.hpp>
 #include <set>
 
@@ -210,3 +211,189 @@ void FinalClean(const vector<vector<Point>> &in, vector<vector<Point>> &out,
 		}
 	}
 }
+
+//***** Same stages on a ContourSet *****
+void CleanBasic(const ContourSet &set, vector<int> &ids,
+	const double min_length, const double max_length)
+{
+	int Nb = 0;
+	for (const int id : ids) {
+		if (set.Count(id) < 4) continue;
+		const double peri = set.Perimeter(id);
+		if (min_length <= peri && peri <= max_length) {
+			ids[Nb++] = id;
+		}
+	}
+	ids.resize(Nb);
+}
+
+void Hulls(const ContourSet &in, vector<int> &ids, ContourSet &out,
+	const double min_length, const double max_length)
+{
+	//OpenCV wants interleaved points: one copy buffer for the whole stage
+	vector<Point> Cont, H;
+	out.Clear();
+	for (const int id : ids) {
+		in.Get(id, Cont);
+		convexHull(Cont, H);
+		const double peri = arcLength(H, true);
+		if (H.size() >= 4 && min_length <= peri && peri <= max_length) {
+			out.Add(H);
+		}
+	}
+	ids.resize(out.Size());
+	for (int k = 0; k < out.Size(); ++k) ids[k] = k;
+}
+
+void Approxs(const ContourSet &in, vector<int> &ids, ContourSet &out,
+	const double min_length, const double max_length)
+{
+	vector<Point> Cont, A;
+	out.Clear();
+	for (const int id : ids) {
+		in.Get(id, Cont);
+		const double peri = in.Perimeter(id);
+		approxPolyDP(Cont, A, 0.02 * peri, true);
+		const double peri2 = arcLength(A, true);
+		if (A.size() >= 4 && min_length <= peri2 && peri2 <= max_length) {
+			out.Add(A);
+		}
+	}
+	ids.resize(out.Size());
+	for (int k = 0; k < out.Size(); ++k) ids[k] = k;
+}
+
+void Rects(const ContourSet &in, vector<int> &ids, ContourSet &out,
+	const double min_length, const double max_length)
+{
+	vector<Point> Cont;
+	out.Clear();
+	for (const int id : ids) {
+		in.Get(id, Cont);
+		RotatedRect box = minAreaRect(Cont);
+		const double peri = 2 * (box.size.height + box.size.width);
+		if (min_length <= peri && peri <= max_length) {
+			Point2f vertices[4];
+			box.points(vertices);
+			Point R[4];
+			for (int v = 0; v < 4; ++v) {
+				R[v] = Point(cvRound(vertices[v].x), cvRound(vertices[v].y));
+			}
+			out.Add(R, 4);
+		}
+	}
+	ids.resize(out.Size());
+	for (int k = 0; k < out.Size(); ++k) ids[k] = k;
+}
+
+void Extract4Corners(const ContourSet &in, vector<int> &ids, ContourSet &out,
+	const double min_length, const double max_length)
+{
+	out.Clear();
+	for (const int id : ids) {
+		const double Peri = in.Perimeter(id);
+		if (Peri < min_length || max_length < Peri) continue;
+		const int Nb_points = in.Count(id);
+		const int *X = in.X(id), *Y = in.Y(id);
+		if (Nb_points == 4) {
+			Point Quad[4];
+			for (int k = 0; k < 4; ++k) Quad[k] = Point(X[k], Y[k]);
+			out.Add(Quad, 4);
+		}
+		else if (Nb_points > 4) {
+			//Same Ids order as above, integer distances and cross products (Kernels.cpp)
+			int Ids[4];
+			QuadCorners(X, Y, Nb_points, Ids);
+
+			//***** Copy to out ****
+			//The 4 corners must be different (no set, it would allocate)
+			bool Distinct = true;
+			for (int a = 0; a < 3; ++a) {
+				for (int b = a + 1; b < 4; ++b) {
+					if (Ids[a] == Ids[b]) Distinct = false;
+				}
+			}
+			if (Distinct) {
+				const Point Quad[4] = {
+					Point(X[Ids[2]], Y[Ids[2]]),	// First Point Of Diag
+					Point(X[Ids[0]], Y[Ids[0]]),	// Left Point
+					Point(X[Ids[3]], Y[Ids[3]]),	// Second Point of Diag
+					Point(X[Ids[1]], Y[Ids[1]])		// Right Point
+				};
+				out.Add(Quad, 4);
+				const double Peri2 = out.Perimeter(out.Size() - 1);
+				if (Peri2 < min_length || max_length < Peri2) out.RemoveLast();
+			}
+		}
+	}
+	ids.resize(out.Size());
+	for (int k = 0; k < out.Size(); ++k) ids[k] = k;
+}
+
+void HullQuads(const ContourSet &in, vector<int> &ids, ContourSet &out,
+	const double min_length, const double max_length)
+{
+	HullBuffers Hull;
+	out.Clear();
+	for (const int id : ids) {
+		const double Peri = in.Perimeter(id);
+		if (Peri < min_length || max_length < Peri) continue;
+		Point Quad[4];
+		if (!HullQuad(in.X(id), in.Y(id), in.Count(id), Hull, Quad)) continue;
+		out.Add(Quad, 4);
+		const double Peri2 = out.Perimeter(out.Size() - 1);
+		if (Peri2 < min_length || max_length < Peri2) out.RemoveLast();
+	}
+	ids.resize(out.Size());
+	for (int k = 0; k < out.Size(); ++k) ids[k] = k;
+}
+
+//Same verifications as above, the removed contours are marked instead of erased
+void FinalClean(const ContourSet &set, vector<int> &ids,
+	const double min_length, const double max_length,
+	const double min_center_dist, const double side_ratio)
+{
+	if (ids.empty()) return;
+	//Sort by Area (computed once by contour)
+	vector<double> Areas(set.Size());
+	for (const int id : ids) Areas[id] = set.Area(id);
+	stable_sort(ids.begin(), ids.end(), [&Areas](const int a, const int b) { return Areas[a] > Areas[b]; });
+
+	//length check + Doubles & inside suppress
+	const int Nb = int(ids.size());
+	vector<char> Removed(Nb, 0);
+	for (int i = 0; i < Nb - 1; ++i) {
+		if (Removed[i]) continue;
+		const double Peri = set.Perimeter(ids[i]);
+		if (min_length <= Peri && Peri <= max_length) {
+			const Point Center1 = set.Center(ids[i]);
+			const int Radius = SquaredDist(Center1, set.At(ids[i], 0));
+			for (int j = i + 1; j < Nb; ++j) {
+				if (Removed[j]) continue;
+				const int Center_dist = SquaredDist(Center1, set.Center(ids[j]));
+				if (Center_dist < min_center_dist || Center_dist < Radius) {
+					Removed[j] = 1;
+				}
+			}
+		}
+	}
+
+	//Shape Verification
+	const double Ratio_min = 1 - side_ratio, Ratio_max = 1 + side_ratio;
+	int Nb_kept = 0;
+	for (int i = 0; i < Nb; ++i) {
+		if (Removed[i]) continue;
+		const int id = ids[i];
+		int Sides[4];
+		Sides[0] = SquaredDist(set.At(id, 0), set.At(id, 1));
+		Sides[1] = SquaredDist(set.At(id, 2), set.At(id, 3));
+		Sides[2] = SquaredDist(set.At(id, 1), set.At(id, 2));
+		Sides[3] = SquaredDist(set.At(id, 3), set.At(id, 0));
+		const double Ratio_1 = 1.0 * Sides[0] / Sides[1],
+			Ratio_2 = 1.0 * Sides[2] / Sides[3];
+		if (!(Ratio_min > Ratio_1 || Ratio_1 > Ratio_max || Ratio_min > Ratio_2 || Ratio_2 > Ratio_max)) {
+			ids[Nb_kept++] = id;
+		}
+	}
+	ids.resize(Nb_kept);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "opencv2/core.hpp"
+#include "ContourSet.hpp"
 #include <vector>
 
 //Basic fast clean only number of point and length
@@ -23,3 +24,29 @@ void Extract4Corners(const std::vector<std::vector<cv::Point>> &in, std::vector<
 void FinalClean(const std::vector<std::vector<cv::Point>> &in, std::vector<std::vector<cv::Point>> &out,
 				double min_length = 600, double max_length = 3600,
 				double min_center_dist = 110, double side_ratio = 0.5);
+
+//***** Same stages on a ContourSet *****
+//ids is the view on the set: the contours to process in, the contours kept out
+//The filters (CleanBasic, FinalClean) only rewrite ids, the others fill out and ids then refers to out
+void CleanBasic(const ContourSet &set, std::vector<int> &ids,
+				double min_length = 600, double max_length = 3600);
+
+void Hulls(const ContourSet &in, std::vector<int> &ids, ContourSet &out,
+		   double min_length = 600, double max_length = 3600);
+
+void Approxs(const ContourSet &in, std::vector<int> &ids, ContourSet &out,
+			 double min_length = 600, double max_length = 3600);
+
+void Rects(const ContourSet &in, std::vector<int> &ids, ContourSet &out,
+		   double min_length = 600, double max_length = 3600);
+
+void Extract4Corners(const ContourSet &in, std::vector<int> &ids, ContourSet &out,
+					 double min_length = 600, double max_length = 3600);
+
+//Replaces Hulls + Approxs + Extract4Corners: quad fitted on the convex hull (HullQuad in Kernels)
+void HullQuads(const ContourSet &in, std::vector<int> &ids, ContourSet &out,
+			   double min_length = 600, double max_length = 3600);
+
+void FinalClean(const ContourSet &set, std::vector<int> &ids,
+				double min_length = 600, double max_length = 3600,
+				double min_center_dist = 110, double side_ratio = 0.5);
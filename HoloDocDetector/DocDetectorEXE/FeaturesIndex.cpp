@@ -0,0 +1,241 @@
+#include "FeaturesIndex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+using namespace std;
+using namespace cv;
+
+template <typename Features>
+FeaturesIndex<Features>::FeaturesIndex(const int m, const int ef_construction, const int ef_search,
+									   const FeaturesCoefs &coefs, const unsigned seed)
+	: _M(MAX(m, 2)), _Ef_construction(MAX(ef_construction, 1)), _Ef_search(MAX(ef_search, 1)),
+	  _Level_mult(1.0 / log(double(MAX(m, 2)))), _Entry(-1), _Top_level(-1), _Removed(0), _Rng(seed), _Mark(0)
+{
+	if (!NormalizedWeights(coefs, _Weights)) {
+		for (float &Weight : _Weights) Weight = 1.0f / (Features::_HistoChans + 1);
+	}
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::Clear()
+{
+	_Nodes.clear();
+	_Rows.clear();
+	_Codes.clear();
+	_Slots.clear();
+	_Visited.clear();
+	_Entry = _Top_level = -1;
+	_Removed = 0;
+}
+
+template <typename Features>
+float FeaturesIndex<Features>::codeDistance(const uchar *a, const uchar *b) const
+{
+	return RowsDistance<Features>(a, b, _Weights) / 255.0f;
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::toCode(const float *row, uchar *code) const
+{
+	for (int i = 0; i < Features::_RowSize; ++i) code[i] = saturate_cast<uchar>(row[i] * 255.0f);
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::Insert(const int id, const Features &features)
+{
+	float Row[Features::_RowSize];
+	features.ToRow(Row);
+	insertRow(id, Row);
+	if (_Removed > 1000 && _Removed > Size()) rebuild();
+}
+
+template <typename Features>
+bool FeaturesIndex<Features>::Remove(const int id)
+{
+	const auto Slot = _Slots.find(id);
+	if (Slot == _Slots.end()) return false;
+	_Nodes[Slot->second].Removed = true;
+	_Slots.erase(Slot);
+	_Removed++;
+	if (_Removed > 1000 && _Removed > Size()) rebuild();
+	return true;
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::insertRow(const int id, const float *row)
+{
+	//Update: the former node becomes a waypoint
+	const auto Slot = _Slots.find(id);
+	if (Slot != _Slots.end()) {
+		_Nodes[Slot->second].Removed = true;
+		_Removed++;
+	}
+
+	//Random layer, exponentially decaying
+	uniform_real_distribution<double> Uniform(0.0, 1.0);
+	const int Level = int(-log(MAX(Uniform(_Rng), 1e-12)) * _Level_mult);
+	const int New = int(_Nodes.size());
+	_Nodes.push_back({id, false, vector<vector<int>>(Level + 1)});
+	_Rows.insert(_Rows.end(), row, row + Features::_RowSize);
+	_Codes.resize(_Codes.size() + Features::_RowSize);
+	toCode(row, &_Codes[size_t(New) * Features::_RowSize]);
+	_Visited.push_back(0);
+	_Slots[id] = New;
+	if (_Entry < 0) {
+		_Entry = New;
+		_Top_level = Level;
+		return;
+	}
+
+	//Greedy descent on the layers above the node, then its neighbours on each of its layers
+	const uchar *Code = code(New);
+	int Current = _Entry;
+	vector<Candidate> Found;
+	for (int l = _Top_level; l > Level; --l) {
+		searchLayer(Code, Current, 1, l, false, Found);
+		Current = Found[0].second;
+	}
+	for (int l = MIN(Level, _Top_level); l >= 0; --l) {
+		searchLayer(Code, Current, _Ef_construction, l, false, Found);
+		Current = Found[0].second;
+		const int Max_links = l == 0 ? 2 * _M : _M;
+		selectNeighbours(Found, _M);
+		for (const Candidate &Neighbour : Found) {
+			_Nodes[New].Links[l].push_back(Neighbour.second);
+
+			//Back link, the neighbour keeps its best ones if it has too many
+			vector<int> &Links = _Nodes[Neighbour.second].Links[l];
+			Links.push_back(New);
+			if (int(Links.size()) <= Max_links) continue;
+			const uchar *From = code(Neighbour.second);
+			vector<Candidate> Kept;
+			for (const int Link : Links) Kept.emplace_back(codeDistance(From, code(Link)), Link);
+			sort(Kept.begin(), Kept.end());
+			selectNeighbours(Kept, Max_links);
+			Links.clear();
+			for (const Candidate &Link : Kept) Links.push_back(Link.second);
+		}
+	}
+	if (Level > _Top_level) {
+		_Entry = New;
+		_Top_level = Level;
+	}
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::searchLayer(const uchar *query, const int entry, const int ef, const int level,
+										  const bool skip_removed, vector<Candidate> &found) const
+{
+	//New marks, reset when they wrap
+	if (++_Mark == 0) {
+		fill(_Visited.begin(), _Visited.end(), 0);
+		_Mark = 1;
+	}
+
+	//Candidates to expand (closest first) and the ef closest nodes (farthest first)
+	priority_queue<Candidate, vector<Candidate>, greater<Candidate>> To_expand;
+	priority_queue<Candidate> Closest;
+	const float Entry_dist = codeDistance(query, code(entry));
+	To_expand.emplace(Entry_dist, entry);
+	if (!skip_removed || !_Nodes[entry].Removed) Closest.emplace(Entry_dist, entry);
+	_Visited[entry] = _Mark;
+	float Bound = Closest.empty() ? FLT_MAX : Closest.top().first;
+
+	while (!To_expand.empty()) {
+		const Candidate Current = To_expand.top();
+		if (Current.first > Bound && int(Closest.size()) == ef) break;
+		To_expand.pop();
+		for (const int Link : _Nodes[Current.second].Links[level]) {
+			if (_Visited[Link] == _Mark) continue;
+			_Visited[Link] = _Mark;
+			const float Dist = codeDistance(query, code(Link));
+			if (int(Closest.size()) == ef && Dist >= Bound) continue;
+			To_expand.emplace(Dist, Link);
+			if (skip_removed && _Nodes[Link].Removed) continue;
+			Closest.emplace(Dist, Link);
+			if (int(Closest.size()) > ef) Closest.pop();
+			Bound = Closest.top().first;
+		}
+	}
+
+	found.resize(Closest.size());
+	for (int i = int(Closest.size()) - 1; i >= 0; --i, Closest.pop()) found[i] = Closest.top();
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::selectNeighbours(vector<Candidate> &candidates, const int m) const
+{
+	if (int(candidates.size()) <= m) return;
+	vector<Candidate> Kept;
+	for (const Candidate &C : candidates) {
+		if (int(Kept.size()) == m) break;
+		bool Good = true;
+		for (size_t k = 0; k < Kept.size() && Good; ++k) {
+			Good = codeDistance(code(C.second), code(Kept[k].second)) >= C.first;
+		}
+		if (Good) Kept.push_back(C);
+	}
+	candidates.swap(Kept);
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::Search(const Features &query, const int k, vector<int> &ids, vector<float> &dists) const
+{
+	ids.clear();
+	dists.clear();
+	if (k <= 0 || _Slots.empty()) return;
+
+	float Row[Features::_RowSize];
+	uchar Code[Features::_RowSize];
+	query.ToRow(Row);
+	toCode(Row, Code);
+
+	int Current = _Entry;
+	vector<Candidate> Found;
+	for (int l = _Top_level; l > 0; --l) {
+		searchLayer(Code, Current, 1, l, false, Found);
+		Current = Found[0].second;
+	}
+	searchLayer(Code, Current, MAX(_Ef_search, k), 0, true, Found);
+
+	//Exact re-ranking of the candidates
+	for (Candidate &C : Found) {
+		C.first = RowsDistance<Features>(Row, &_Rows[size_t(C.second) * Features::_RowSize], _Weights);
+	}
+	sort(Found.begin(), Found.end());
+	for (int i = 0; i < MIN(k, int(Found.size())); ++i) {
+		ids.push_back(_Nodes[Found[i].second].Id);
+		dists.push_back(Found[i].first);
+	}
+}
+
+template <typename Features>
+bool FeaturesIndex<Features>::Distance(const Features &query, const int id, float &dist) const
+{
+	const auto Slot = _Slots.find(id);
+	if (Slot == _Slots.end()) return false;
+	float Row[Features::_RowSize];
+	query.ToRow(Row);
+	dist = RowsDistance<Features>(Row, &_Rows[size_t(Slot->second) * Features::_RowSize], _Weights);
+	return true;
+}
+
+template <typename Features>
+void FeaturesIndex<Features>::rebuild()
+{
+	vector<int> Ids;
+	vector<float> Rows;
+	for (const Node &N : _Nodes) {
+		if (N.Removed) continue;
+		const size_t Node_id = &N - &_Nodes[0];
+		Ids.push_back(N.Id);
+		Rows.insert(Rows.end(), &_Rows[Node_id * Features::_RowSize], &_Rows[(Node_id + 1) * Features::_RowSize]);
+	}
+	Clear();
+	for (size_t i = 0; i < Ids.size(); ++i) insertRow(Ids[i], &Rows[i * Features::_RowSize]);
+}
+
+//***** Layouts *****
+template class FeaturesIndex<DocFeatures>;
+template class FeaturesIndex<ServerFeatures>;
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Im_Features.hpp"
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+//Approximate nearest neighbours of document features: hierarchical navigable small world graph (HNSW)
+//The graph is walked on 8-bit codes of the rows, the candidates found are re-ranked on the float rows (distance of MatchTopK)
+//A removed document stays in the graph as a waypoint until the graph is rebuilt, when they outnumber the documents
+//Search is const but not thread safe (marks of the visited nodes)
+template <typename Features>
+class FeaturesIndex
+{
+public:
+	//m: links of a node on each layer (2 m on the ground one), ef_construction: candidates of an insert,
+	//ef_search: candidates of a search, the larger the better the recall and the slower
+	explicit FeaturesIndex(int m = 16, int ef_construction = 128, int ef_search = 64,
+						   const FeaturesCoefs &coefs = Features::DefaultCoefs(), unsigned seed = 42);
+
+	void SetSearch(int ef_search) { _Ef_search = MAX(ef_search, 1); }
+	//Add a document, or update it if id is already in the index
+	void Insert(int id, const Features &features);
+	//False if id isn't in the index
+	bool Remove(int id);
+	//The k documents the closest to query, closest first (dists: see MatchTopK)
+	void Search(const Features &query, int k, std::vector<int> &ids, std::vector<float> &dists) const;
+	//Exact distance of query to the document id (see MatchTopK), false if id isn't in the index
+	bool Distance(const Features &query, int id, float &dist) const;
+	int Size() const { return int(_Slots.size()); }
+	//Removed and former versions of updated documents, kept in the graph until it is rebuilt
+	int Waypoints() const { return _Removed; }
+	void Clear();
+
+private:
+	typedef std::pair<float, int> Candidate;	// Distance, node
+
+	struct Node
+	{
+		int Id;
+		bool Removed;
+		std::vector<std::vector<int>> Links;	// Neighbours on each layer of the node
+	};
+
+	int _M, _Ef_construction, _Ef_search;
+	double _Level_mult;
+	float _Weights[Features::_HistoChans + 1];
+	std::vector<Node> _Nodes;
+	std::vector<float> _Rows;				// Float rows of the nodes (re-ranking)
+	std::vector<uchar> _Codes;				// 8-bit rows of the nodes (walk)
+	std::unordered_map<int, int> _Slots;	// Node of each document
+	int _Entry, _Top_level, _Removed;
+	std::mt19937 _Rng;
+	mutable std::vector<unsigned> _Visited;
+	mutable unsigned _Mark;
+
+	const uchar *code(int node) const { return &_Codes[size_t(node) * Features::_RowSize]; }
+	float codeDistance(const uchar *a, const uchar *b) const;
+	void toCode(const float *row, uchar *code) const;
+	void insertRow(int id, const float *row);
+	//Closest nodes of a layer from an entry, ascending (removed nodes are walked but not kept if skip_removed)
+	void searchLayer(const uchar *query, int entry, int ef, int level, bool skip_removed, std::vector<Candidate> &found) const;
+	//At most m of the candidates (ascending), keeping a neighbour only if it's closer to the node than to those kept
+	void selectNeighbours(std::vector<Candidate> &candidates, int m) const;
+	void rebuild();
+};
+
+typedef FeaturesIndex<DocFeatures> DocIndex;
+typedef FeaturesIndex<ServerFeatures> ServerIndex;
@@ -0,0 +1,152 @@
+#include "FeaturesPQ.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+const int PQ_CENTROIDS = 256;	// One byte by sub-vector
+
+template <typename Features>
+FeaturesPQ<Features>::FeaturesPQ(const int sub_dims, const FeaturesCoefs &coefs): _Sub_dims(MAX(sub_dims, 1))
+{
+	if (!NormalizedWeights(coefs, _Weights)) {
+		for (float &Weight : _Weights) Weight = 1.0f / (Features::_HistoChans + 1);
+	}
+
+	//Blocks of the row: the HOG then the histograms, cut in sub-vectors of at most sub_dims values
+	int Offset = 0;
+	for (int b = 0; b <= Features::_HistoChans; ++b) {
+		const int Size = b == 0 ? Features::_HOGBins : Features::_HistoBins, Nb_subs = (Size + _Sub_dims - 1) / _Sub_dims;
+		_Block_first[b] = int(_Subs.size());
+		for (int s = 0; s < Nb_subs; ++s) {
+			//Even cut: the sub-vectors of a block differ by one value at most
+			const int Begin = s * Size / Nb_subs, End = (s + 1) * Size / Nb_subs;
+			_Subs.push_back({b, Offset + Begin, End - Begin});
+		}
+		Offset += Size;
+	}
+	_Block_first[Features::_HistoChans + 1] = int(_Subs.size());
+}
+
+template <typename Features>
+bool FeaturesPQ<Features>::Train(const Mat &rows, const int iterations)
+{
+	_Centroids.clear();
+	if (rows.empty() || rows.type() != CV_32FC1 || rows.cols != Features::_RowSize) return false;
+
+	const int K = MIN(PQ_CENTROIDS, rows.rows);
+	for (const SubVector &Sub : _Subs) {
+		Mat Data(rows.rows, Sub.Dims, CV_32FC1), Labels, Centers;
+		for (int r = 0; r < rows.rows; ++r) copy_n(rows.ptr<float>(r) + Sub.Offset, Sub.Dims, Data.ptr<float>(r));
+		kmeans(Data, K, Labels, TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, iterations, 1e-6), 1, KMEANS_PP_CENTERS,
+			   Centers);
+		_Centroids.push_back(Centers);
+	}
+	return true;
+}
+
+template <typename Features>
+bool FeaturesPQ<Features>::Encode(const float *row, uchar *code) const
+{
+	if (!Trained()) return false;
+	for (size_t s = 0; s < _Subs.size(); ++s) {
+		const float *Sub = row + _Subs[s].Offset;
+		const Mat &Centers = _Centroids[s];
+		float Best = FLT_MAX;
+		code[s] = 0;
+		for (int c = 0; c < Centers.rows; ++c) {
+			const float *Center = Centers.ptr<float>(c);
+			float Dist = 0.0f;
+			for (int d = 0; d < _Subs[s].Dims; ++d) Dist += (Sub[d] - Center[d]) * (Sub[d] - Center[d]);
+			if (Dist < Best) {
+				Best = Dist;
+				code[s] = uchar(c);
+			}
+		}
+	}
+	return true;
+}
+
+template <typename Features>
+bool FeaturesPQ<Features>::Encode(const Mat &rows, Mat &codes) const
+{
+	if (!Trained() || rows.empty() || rows.type() != CV_32FC1 || rows.cols != Features::_RowSize) {
+		codes.release();
+		return false;
+	}
+	codes.create(rows.rows, CodeSize(), CV_8UC1);
+	for (int r = 0; r < rows.rows; ++r) Encode(rows.ptr<float>(r), codes.ptr<uchar>(r));
+	return true;
+}
+
+template <typename Features>
+void FeaturesPQ<Features>::Match(const Features &query, const Mat &codes, const int k, const int rerank,
+								 const function<void(int, float *)> &load, vector<int> &ids, vector<float> &dists) const
+{
+	ids.clear();
+	dists.clear();
+	if (k <= 0 || !Trained() || codes.empty() || codes.type() != CV_8UC1 || codes.cols != CodeSize()) return;
+
+	float Query[Features::_RowSize];
+	query.ToRow(Query);
+
+	//Squared distances of each sub-vector of the query to its centroids
+	const int Nb_subs = CodeSize();
+	vector<float> Table(size_t(Nb_subs) * PQ_CENTROIDS, 0.0f);
+	for (int s = 0; s < Nb_subs; ++s) {
+		const float *Sub = Query + _Subs[s].Offset;
+		for (int c = 0; c < _Centroids[s].rows; ++c) {
+			const float *Center = _Centroids[s].ptr<float>(c);
+			float Dist = 0.0f;
+			for (int d = 0; d < _Subs[s].Dims; ++d) Dist += (Sub[d] - Center[d]) * (Sub[d] - Center[d]);
+			Table[s * PQ_CENTROIDS + c] = Dist;
+		}
+	}
+
+	//First stage on the codes: max-heap of the best ones, a code is abandoned once its partial distance passes the worst
+	const bool Exact = rerank > 0 && load;
+	const int Nb_best = Exact ? MAX(k, rerank) : k;
+	vector<pair<float, int>> Heap;
+	Heap.reserve(Nb_best + 1);
+	float Worst = FLT_MAX;
+	for (int r = 0; r < codes.rows; ++r) {
+		const uchar *Code = codes.ptr<uchar>(r);
+		float Dist = 0.0f;
+		for (int b = 0; b <= Features::_HistoChans && Dist < Worst; ++b) {
+			if (_Weights[b] == 0.0f) continue;
+			float Squared = 0.0f;
+			for (int s = _Block_first[b]; s < _Block_first[b + 1]; ++s) Squared += Table[s * PQ_CENTROIDS + Code[s]];
+			Dist += _Weights[b] * sqrt(Squared);
+		}
+		if (Dist >= Worst) continue;
+
+		Heap.emplace_back(Dist, r);
+		push_heap(Heap.begin(), Heap.end());
+		if (int(Heap.size()) > Nb_best) {
+			pop_heap(Heap.begin(), Heap.end());
+			Heap.pop_back();
+		}
+		if (int(Heap.size()) == Nb_best) Worst = Heap.front().first;
+	}
+
+	//Exact re-ranking of the candidates on their rows
+	if (Exact) {
+		float Row[Features::_RowSize];
+		for (pair<float, int> &Candidate : Heap) {
+			load(Candidate.second, Row);
+			Candidate.first = RowsDistance<Features>(Query, Row, _Weights);
+		}
+		sort(Heap.begin(), Heap.end());
+	}
+	else sort_heap(Heap.begin(), Heap.end());
+
+	for (int i = 0; i < MIN(k, int(Heap.size())); ++i) {
+		ids.push_back(Heap[i].second);
+		dists.push_back(Heap[i].first);
+	}
+}
+
+//***** Layouts *****
+template class FeaturesPQ<DocFeatures>;
+template class FeaturesPQ<ServerFeatures>;
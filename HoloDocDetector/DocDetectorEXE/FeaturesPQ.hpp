@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Im_Features.hpp"
+#include <functional>
+#include <vector>
+
+//Product quantisation of document features: each block (HOG, H, S, V, B, G, R) is cut in sub-vectors of sub_dims values,
+//each sub-vector is coded by the byte of its closest centroid (k-means codebook of 256 centroids by sub-vector)
+//By default sub-vectors of 4 values for 10 bins (21 bytes by document) and of 5 values for 25 bins (32 bytes), instead of the
+//float rows of 280 and 640 bytes (4 values for 25 bins would take 45 bytes)
+//The distance to a code is asymmetric: the query stays exact, one lookup table of squared distances by sub-vector
+template <typename Features>
+class FeaturesPQ
+{
+public:
+	static const int _Default_sub_dims = Features::_HistoBins <= 10 ? 4 : 5;
+
+	explicit FeaturesPQ(int sub_dims = _Default_sub_dims, const FeaturesCoefs &coefs = Features::DefaultCoefs());
+
+	//Codebooks learned on rows of a features matrix (CV_32FC1, one ToRow by row), false if there are no rows
+	bool Train(const cv::Mat &rows, int iterations = 20);
+	bool Trained() const { return !_Centroids.empty(); }
+	//Bytes of a code
+	int CodeSize() const { return int(_Subs.size()); }
+	//Code of a row of CodeSize bytes, false if the codebooks aren't trained
+	bool Encode(const float *row, uchar *code) const;
+	//One code by row (CV_8UC1, CodeSize columns), false (and no codes) if the codebooks aren't trained or rows isn't a
+	//features matrix (CV_32FC1, _RowSize columns)
+	bool Encode(const cv::Mat &rows, cv::Mat &codes) const;
+
+	//The k closest documents of the codes, closest first (dists: see MatchTopK)
+	//The rerank closest codes are re-ranked on their exact rows, load(i, row) reads the row of the document i when needed
+	//Without load (or rerank = 0), dists are the distances to the codes
+	void Match(const Features &query, const cv::Mat &codes, int k, int rerank, const std::function<void(int, float *)> &load,
+			   std::vector<int> &ids, std::vector<float> &dists) const;
+
+private:
+	//Sub-vector: a part of a block of the row
+	struct SubVector
+	{
+		int Block, Offset, Dims;
+	};
+
+	int _Sub_dims;
+	float _Weights[Features::_HistoChans + 1];
+	std::vector<SubVector> _Subs;
+	int _Block_first[Features::_HistoChans + 2];	// First sub-vector of each block (and the end)
+	std::vector<cv::Mat> _Centroids;				// Codebook of each sub-vector (CV_32FC1, one centroid by row)
+};
+
+typedef FeaturesPQ<DocFeatures> DocPQ;
+typedef FeaturesPQ<ServerFeatures> ServerPQ;
@@ -1,86 +1,566 @@
 #include "Im_Features.hpp"
+#include "ThreadPool.hpp"
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/hal.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <vector>
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 #include <fstream>
 
 using namespace std;
 using namespace cv;
 
-Im_Features::Im_Features(const int histo_bins, const int hog_bins): _HistoBins(histo_bins), _HOGBins(hog_bins)
+//***** Fused kernel *****
+// Fixed-point BGR to HSV (hue in [0, 180)) and BGR to gray of cvtColor on 8-bit images
+const int HSV_SHIFT = 12,
+		  GRAY_SHIFT = 14, B2Y = 1868, G2Y = 9617, R2Y = 4899;
+
+/// <summary>Divisions of the HSV conversion, same tables as cvtColor.</summary>
+struct HsvTables
+{
+	int Sdiv[256], Hdiv[256];
+
+	HsvTables()
+	{
+		Sdiv[0] = Hdiv[0] = 0;
+		for (int i = 1; i < 256; ++i) {
+			Sdiv[i] = cvRound((255 << HSV_SHIFT) / (1. * i));
+			Hdiv[i] = cvRound((180 << HSV_SHIFT) / (6. * i));
+		}
+	}
+};
+static const HsvTables HSV_TABLES;
+
+/// <summary>Private results of a band of rows, merged at the end.</summary>
+struct FeaturesBand
+{
+	vector<int> Counts;		// Counts of the 256 values of H, S, V, B, G, R in the band
+	vector<double> HOG;
+	double Sum_Mag;
+};
+
+/// <summary>Color counts and HOG of the rows [begin, end) in one read of each row.</summary>
+static void FeaturesRows(const Mat &image, int begin, int end, int hog_bins, FeaturesBand &band);
+
+/// <summary>HSV of a row of BGR pixels, same values as cvtColor (hue in [0, 180)).</summary>
+static void HsvRow(const uchar *bgr, int width, uchar *h, uchar *s, uchar *v);
+
+#if CV_SIMD128
+/// <summary>HSV of 4 pixels (<see cref = "HsvRow"/>).</summary>
+static void Hsv4(const v_int32x4 &b, const v_int32x4 &g, const v_int32x4 &r, v_int32x4 &h, v_int32x4 &s, v_int32x4 &v);
+
+/// <summary>cvRound(num / den) for den in [1, 255] like the HSV tables, num being a multiple of 2^12.</summary>
+static v_int32x4 RoundDiv(int num, const v_int32x4 &den);
+#endif
+
+//***** Distance *****
+#if CV_SIMD128
+/// <summary>Four stored values as float.</summary>
+static inline v_float32x4 Load4(const float *p) { return v_load(p); }
+static inline v_float32x4 Load4(const ushort *p) { return v_cvt_f32(v_reinterpret_as_s32(v_load_expand(p))); }
+static inline v_float32x4 Load4(const uchar *p) { return v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(p))); }
+#endif
+
+/// <summary>Squared L2 distance of two arrays of N values, the loops are unrolled on N by the compiler.</summary>
+template <int N, typename Scalar>
+static float SquaredL2(const Scalar *a, const Scalar *b)
 {
-	_Histograms = vector<double>(_HistoChans*_HistoBins, 0.0);
-	_HOG = vector<double>(_HOGBins, 0.0);
+	int i = 0;
+	float Sum = 0.0f;
+#if CV_SIMD128
+	v_float32x4 Acc = v_setzero_f32();
+	for (; i <= N - 4; i += 4) {
+		const v_float32x4 Diff = Load4(a + i) - Load4(b + i);
+		Acc += Diff * Diff;
+	}
+	Sum = v_reduce_sum(Acc);
+#endif
+	for (; i < N; ++i) {
+		const float Diff = float(a[i]) - float(b[i]);
+		Sum += Diff * Diff;
+	}
+	return Sum;
 }
 
-Im_Features::~Im_Features()
+/// <summary>
+/// Squared L2 distances of four rows to the query on N values from offset, the query is loaded once for the four rows
+/// and the four sums stay in registers. Same operations in the same order as SquaredL2 for each row.
+/// </summary>
+template <int N>
+static void SquaredL2x4(const float *query, const float *const rows[4], const int offset, float sums[4])
 {
-	_HOG.clear();
-	_Histograms.clear();
+	const float *Q = query + offset, *R0 = rows[0] + offset, *R1 = rows[1] + offset, *R2 = rows[2] + offset,
+				*R3 = rows[3] + offset;
+	int i = 0;
+	float S0 = 0.0f, S1 = 0.0f, S2 = 0.0f, S3 = 0.0f;
+#if CV_SIMD128
+	v_float32x4 Acc0 = v_setzero_f32(), Acc1 = v_setzero_f32(), Acc2 = v_setzero_f32(), Acc3 = v_setzero_f32();
+	for (; i <= N - 4; i += 4) {
+		const v_float32x4 V = v_load(Q + i);
+		const v_float32x4 D0 = V - v_load(R0 + i), D1 = V - v_load(R1 + i), D2 = V - v_load(R2 + i), D3 = V - v_load(R3 + i);
+		Acc0 += D0 * D0;
+		Acc1 += D1 * D1;
+		Acc2 += D2 * D2;
+		Acc3 += D3 * D3;
+	}
+	S0 = v_reduce_sum(Acc0);
+	S1 = v_reduce_sum(Acc1);
+	S2 = v_reduce_sum(Acc2);
+	S3 = v_reduce_sum(Acc3);
+#endif
+	for (; i < N; ++i) {
+		const float D0 = Q[i] - R0[i], D1 = Q[i] - R1[i], D2 = Q[i] - R2[i], D3 = Q[i] - R3[i];
+		S0 += D0 * D0;
+		S1 += D1 * D1;
+		S2 += D2 * D2;
+		S3 += D3 * D3;
+	}
+	sums[0] = S0;
+	sums[1] = S1;
+	sums[2] = S2;
+	sums[3] = S3;
 }
 
-void Im_Features::ExtractFeatures(const cv::Mat &image)
+/// <summary>
+/// RowsDistance of four float rows of Features at once (see SquaredL2x4), the blocks stop when the four partial distances
+/// exceed bound. A distance above bound is a lower bound, the others are the ones of RowsDistance.
+/// </summary>
+template <typename Features>
+static void RowsDistance4(const float *query, const float *const rows[4], const float weights[7], const float bound,
+						  float dists[4])
 {
-	extractHistograms(image);
-	extractHOG(image);
+	const int HOG = Features::_HOGBins, Bins = Features::_HistoBins;
+	float Sums[4];
+	for (int j = 0; j < 4; ++j) dists[j] = 0.0f;
+	if (weights[0] != 0.0f) {
+		SquaredL2x4<HOG>(query, rows, 0, Sums);
+		for (int j = 0; j < 4; ++j) dists[j] = weights[0] * sqrt(Sums[j]);
+	}
+	for (int c = 0; c < Features::_HistoChans; ++c) {
+		if (MIN(MIN(dists[0], dists[1]), MIN(dists[2], dists[3])) > bound) break;
+		if (weights[c + 1] == 0.0f) continue;
+		SquaredL2x4<Bins>(query, rows, HOG + c * Bins, Sums);
+		for (int j = 0; j < 4; ++j) dists[j] += weights[c + 1] * sqrt(Sums[j]);
+	}
 }
 
-double Im_Features::Distance(const Im_Features &features, vector<double> coefs)
+template <int HistBins, int HOGBins, typename Scalar>
+Im_Features<HistBins, HOGBins, Scalar>::Im_Features()
 {
+	_Histograms.fill(Scalar(0));
+	_HOG.fill(Scalar(0));
+}
+
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::store(const double hists[_HistoChans * HistBins], const double hog[HOGBins])
+{
+	for (int i = 0; i < _HistoChans * HistBins; ++i) _Histograms[i] = saturate_cast<Scalar>(hists[i] * Scale());
+	for (int i = 0; i < HOGBins; ++i) _HOG[i] = saturate_cast<Scalar>(hog[i] * Scale());
+}
+
+void FeaturesRows(const Mat &image, const int begin, const int end, const int hog_bins, FeaturesBand &band)
+{
+	const int W = image.cols, H = image.rows;
+	const int Step = 360 / hog_bins;
+	const float Inv_step = 1.0f / Step;
+	int *Counts = band.Counts.data();
+	double Sum_Mag = 0.0;
+	//Gray of the rows y - 1, y and y + 1, reflected at the borders like Sobel (the gradient is 0 there)
+	vector<short> Rows(3 * W);
+	short *Prev = Rows.data(), *Cur = Prev + W, *Next = Cur + W;
+	//Gradients, magnitude and angle of the row y
+	vector<float> Polar(4 * W);
+	float *Gx = Polar.data(), *Gy = Gx + W, *Mag = Gy + W, *Angle = Mag + W;
+	//H, S and V of a row
+	vector<uchar> Hsv(3 * W);
+	uchar *Hue = Hsv.data(), *Sat = Hue + W, *Val = Sat + W;
 
-	if (coefs.size() != _HistoChans + 1) coefs = vector<double>(_HistoChans + 1, 1.0);
-	vector<double> Dists_Val(_HistoChans + 1, 0.0);
- 	for (int i = 0; i < _HOG.size(); ++i) {
-		const double Val = _HOG[i] - features._HOG[i];
-		Dists_Val[0] += Val * Val;
+	//Gray of a row, and its colors if it belongs to the band
+	auto Read = [&](const int y, short *gray, const bool count) {
+		const uchar *P = image.ptr<uchar>(y);
+		for (int x = 0; x < W; ++x) {
+			gray[x] = short((P[3 * x] * B2Y + P[3 * x + 1] * G2Y + P[3 * x + 2] * R2Y + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+		}
+		if (!count) return;
+		HsvRow(P, W, Hue, Sat, Val);
+		//Values counted, binned once at the end: no RGB to HSV bins table (16M entries don't stay in the cache)
+		for (int x = 0; x < W; ++x, P += 3) {
+			Counts[Hue[x]]++;
+			Counts[256 + Sat[x]]++;
+			Counts[512 + Val[x]]++;
+			Counts[768 + P[0]]++;
+			Counts[1024 + P[1]]++;
+			Counts[1280 + P[2]]++;
+		}
+	};
+
+	Read(begin, Cur, true);
+	if (begin > 0) Read(begin - 1, Prev, false);
+	else if (H > 1) Read(1, Prev, false);
+	else Prev = Cur;
+	for (int y = begin; y < end; ++y) {
+		if (y + 1 < H) Read(y + 1, Next, y + 1 < end);
+		else Next = Prev;
+
+		//Fixed-point gradients (Sobel of aperture 1, gray levels instead of [0, 1] cancel in the normalization)
+		Gx[0] = Gx[W - 1] = 0.0f;
+		for (int x = 1; x < W - 1; ++x) Gx[x] = float(Cur[x + 1] - Cur[x - 1]);
+		for (int x = 0; x < W; ++x) Gy[x] = float(Next[x] - Prev[x]);
+		//Vectorised polar coordinates of cartToPolar, on one row
+		hal::magnitude(Gx, Gy, Mag, W);
+		hal::fastAtan2(Gy, Gx, Angle, W, true);
+		//Same two bins as extractHOG, without branches (a null gradient adds 0): the bin of each pixel and its weights
+		//for the bin and the next one replace the angle and the gradients
+		float *Bin = Angle, *To_bin = Gx, *To_next = Gy;
+		int x = 0;
+		float Row_mag = 0.0f;
+#if CV_SIMD128
+		const v_float32x4 Inv_step4 = v_setall_f32(Inv_step), Half = v_setall_f32(0.5f), One = v_setall_f32(1.0f);
+		const v_int32x4 Nb_bins = v_setall_s32(hog_bins);
+		v_float32x4 Mag_sum = v_setzero_f32();
+		for (; x <= W - 4; x += 4) {
+			const v_float32x4 Bins_Range = v_load(Angle + x) * Inv_step4, M = v_load(Mag + x);
+			v_int32x4 Idx = v_floor(Bins_Range);
+			v_float32x4 Ratio = Bins_Range - v_cvt_f32(Idx);
+			Ratio -= (Ratio > Half) & Half;
+			Idx -= (Idx >= Nb_bins) & Nb_bins;
+			v_store(Bin + x, v_cvt_f32(Idx));
+			v_store(To_bin + x, Ratio * M);
+			v_store(To_next + x, (One - Ratio) * M);
+			Mag_sum += M;
+		}
+		Row_mag = v_reduce_sum(Mag_sum);
+#endif
+		for (; x < W; ++x) {
+			const float Bins_Range = Angle[x] * Inv_step;
+			int Idx = cvFloor(Bins_Range);
+			float Ratio = Bins_Range - Idx;
+			Ratio -= Ratio > 0.5f ? 0.5f : 0.0f;
+			//Same modulo fold as extractHOG: an angle rounded to 360 is in the first bin, the next of the last bin too
+			Idx -= Idx >= hog_bins ? hog_bins : 0;
+			Bin[x] = float(Idx);
+			To_bin[x] = Ratio * Mag[x];
+			To_next[x] = (1.0f - Ratio) * Mag[x];
+			Row_mag += Mag[x];
+		}
+		//Then one sweep of the row by bin, the weights of its pixels are summed under a mask
+		//(no scattered writes waiting for each other when neighbours have the same bin)
+		for (int b = 0; b < hog_bins; ++b) {
+			float Sum_bin = 0.0f, Sum_next = 0.0f;
+			x = 0;
+#if CV_SIMD128
+			const v_float32x4 B = v_setall_f32(float(b));
+			v_float32x4 Acc_bin = v_setzero_f32(), Acc_next = v_setzero_f32();
+			for (; x <= W - 4; x += 4) {
+				const v_float32x4 Mask = v_load(Bin + x) == B;
+				Acc_bin += v_load(To_bin + x) & Mask;
+				Acc_next += v_load(To_next + x) & Mask;
+			}
+			Sum_bin = v_reduce_sum(Acc_bin);
+			Sum_next = v_reduce_sum(Acc_next);
+#endif
+			for (; x < W; ++x) {
+				if (Bin[x] != float(b)) continue;
+				Sum_bin += To_bin[x];
+				Sum_next += To_next[x];
+			}
+			band.HOG[b] += Sum_bin;
+			band.HOG[b + 1 < hog_bins ? b + 1 : 0] += Sum_next;
+		}
+		Sum_Mag += Row_mag;
+		short *Tmp = Prev;
+		Prev = Cur;
+		Cur = Next;
+		Next = Tmp;
 	}
-	
-	for (int i = 0; i < _HistoChans; ++i) {
-		const int idx = i * _HistoBins;
-		for (int j = 0; j < _HistoBins; ++j) {
-			const double Val = _Histograms[idx + j] - features._Histograms[idx + j];
-			Dists_Val[i+1] += Val * Val;
+	band.Sum_Mag = Sum_Mag;
+}
+
+void HsvRow(const uchar *bgr, const int width, uchar *h, uchar *s, uchar *v)
+{
+	int x = 0;
+#if CV_SIMD128
+	//16 pixels per iteration, on 32 bits by 4
+	for (; x <= width - 16; x += 16) {
+		v_uint8x16 B, G, R;
+		v_load_deinterleave(bgr + 3 * x, B, G, R);
+		v_uint16x8 B16[2], G16[2], R16[2];
+		v_expand(B, B16[0], B16[1]);
+		v_expand(G, G16[0], G16[1]);
+		v_expand(R, R16[0], R16[1]);
+		v_int32x4 H32[4], S32[4], V32[4];
+		for (int k = 0; k < 2; ++k) {
+			v_uint32x4 B32[2], G32[2], R32[2];
+			v_expand(B16[k], B32[0], B32[1]);
+			v_expand(G16[k], G32[0], G32[1]);
+			v_expand(R16[k], R32[0], R32[1]);
+			for (int j = 0; j < 2; ++j) {
+				Hsv4(v_reinterpret_as_s32(B32[j]), v_reinterpret_as_s32(G32[j]), v_reinterpret_as_s32(R32[j]),
+					 H32[2 * k + j], S32[2 * k + j], V32[2 * k + j]);
+			}
+		}
+		v_store(h + x, v_pack_u(v_pack(H32[0], H32[1]), v_pack(H32[2], H32[3])));
+		v_store(s + x, v_pack_u(v_pack(S32[0], S32[1]), v_pack(S32[2], S32[3])));
+		v_store(v + x, v_pack_u(v_pack(V32[0], V32[1]), v_pack(V32[2], V32[3])));
+	}
+#endif
+	for (; x < width; ++x) {
+		const int b = bgr[3 * x], g = bgr[3 * x + 1], r = bgr[3 * x + 2];
+		const int Val = MAX(MAX(b, g), r), Diff = Val - MIN(MIN(b, g), r);
+		int Hue = Val == r ? g - b : Val == g ? b - r + 2 * Diff : r - g + 4 * Diff;
+		Hue = (Hue * HSV_TABLES.Hdiv[Diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+		h[x] = uchar(Hue + (Hue < 0 ? 180 : 0));
+		s[x] = uchar((Diff * HSV_TABLES.Sdiv[Val] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT);
+		v[x] = uchar(Val);
+	}
+}
+
+#if CV_SIMD128
+void Hsv4(const v_int32x4 &b, const v_int32x4 &g, const v_int32x4 &r, v_int32x4 &h, v_int32x4 &s, v_int32x4 &v)
+{
+	const v_int32x4 One = v_setall_s32(1), Round = v_setall_s32(1 << (HSV_SHIFT - 1));
+	v = v_max(v_max(b, g), r);
+	const v_int32x4 Diff = v - v_min(v_min(b, g), r);
+	//A null divider of the tables gives 0, its dividend is 0 too (no saturation, no hue): any quotient does
+	s = (Diff * RoundDiv(255 << HSV_SHIFT, v_max(v, One)) + Round) >> HSV_SHIFT;
+	h = v_select(v == r, g - b, v_select(v == g, b - r + (Diff << 1), r - g + (Diff << 2)));
+	h = (h * RoundDiv((180 << HSV_SHIFT) / 6, v_max(Diff, One)) + Round) >> HSV_SHIFT;
+	h += (h < v_setzero_s32()) & v_setall_s32(180);
+}
+
+v_int32x4 RoundDiv(const int num, const v_int32x4 &den)
+{
+	//Float quotient (not always rounded right on NEON) then integer correction by the remainder,
+	//there is no tie: 2 * num is a multiple of 2^13 and den is below it
+	const v_int32x4 Num = v_setall_s32(num);
+	v_int32x4 Quot = v_round(v_setall_f32(float(num)) / v_cvt_f32(den));
+	const v_int32x4 Rem = Num - Quot * den, Rem2 = Rem + Rem;
+	Quot -= Rem2 > den;
+	Quot += Rem2 < v_setzero_s32() - den;
+	return Quot;
+}
+#endif
+
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::ExtractFeatures(const cv::Mat &image, const int nb_threads)
+{
+	double Hists[_HistoChans * HistBins] = {0}, HOG[HOGBins] = {0};
+	if (image.empty() || image.type() != CV_8UC3) {
+		store(Hists, HOG);
+		return;
+	}
+
+	//Private histograms by band, no lock
+	const int Nb_bands = BandsCount(image.rows, nb_threads);
+	vector<FeaturesBand> Bands(Nb_bands);
+	ParallelBands(image.rows, Nb_bands, nb_threads, [&](const int band, const int begin, const int end) {
+		FeaturesBand &Band = Bands[band];
+		Band.Counts.assign(_HistoChans * 256, 0);
+		Band.HOG.assign(HOGBins, 0.0);
+		Band.Sum_Mag = 0.0;
+		FeaturesRows(image, begin, end, HOGBins, Band);
+	});
+
+	double Sum_Mag = 0.0;
+	for (const FeaturesBand &Band : Bands) {
+		//Same bins as calcHist on [0, 256)
+		for (int c = 0; c < _HistoChans; ++c) {
+			for (int v = 0; v < 256; ++v) Hists[c * HistBins + ((v * HistBins) >> 8)] += Band.Counts[c * 256 + v];
+		}
+		for (int i = 0; i < HOGBins; ++i) HOG[i] += Band.HOG[i];
+		Sum_Mag += Band.Sum_Mag;
+	}
+	const double Nb_Points = double(image.rows) * image.cols;
+	for (double &Val : Hists) Val /= Nb_Points;
+	if (Sum_Mag != 0.0) {
+		for (double &Val : HOG) Val /= Sum_Mag;
+	}
+	store(Hists, HOG);
+}
+
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::ExtractFeaturesOpenCV(const cv::Mat &image)
+{
+	double Hists[_HistoChans * HistBins] = {0}, HOG[HOGBins] = {0};
+	extractHistograms(image, Hists);
+	extractHOG(image, HOG);
+	store(Hists, HOG);
+}
+
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::ExtractFeaturesInQuad(const cv::Mat &src, const vector<Point> &quad, const int step)
+{
+	double Hists[_HistoChans * HistBins] = {0}, HOG[HOGBins] = {0};
+	store(Hists, HOG);
+	if (src.empty() || src.type() != CV_8UC3 || quad.size() != 4 || step < 1) return;
+
+	//Quad to unit square: the rectified document up to a scale on each axis, it cancels in the normalization
+	const Point2f Corners[4] = {Point2f(quad[0]), Point2f(quad[1]), Point2f(quad[2]), Point2f(quad[3])},
+				  Square[4] = {Point2f(0.0f, 0.0f), Point2f(1.0f, 0.0f), Point2f(1.0f, 1.0f), Point2f(0.0f, 1.0f)};
+	const Matx33d G = getPerspectiveTransform(Corners, Square);
+	//Area covered on the document by a pixel: jacobian of the homography, det(G) / z^3
+	const double Det = determinant(G);
+
+	int Y_min = quad[0].y, Y_max = quad[0].y;
+	for (int k = 1; k < 4; ++k) {
+		Y_min = MIN(Y_min, quad[k].y);
+		Y_max = MAX(Y_max, quad[k].y);
+	}
+	Y_min = MAX(Y_min, 0);
+	Y_max = MIN(Y_max, src.rows - 1);
+
+	Mat Row_HSV;
+	double Sum_Weights = 0.0;
+	for (int y = Y_min; y <= Y_max; y += step) {
+		//Scanline: span of the row between the edges it crosses
+		double X_left = src.cols, X_right = -1;
+		for (int k = 0; k < 4; ++k) {
+			const Point &P = quad[k], &Q = quad[(k + 1) % 4];
+			if (P.y == Q.y || y < MIN(P.y, Q.y) || MAX(P.y, Q.y) < y) continue;
+			const double X = P.x + double(y - P.y) * (Q.x - P.x) / (Q.y - P.y);
+			X_left = MIN(X_left, X);
+			X_right = MAX(X_right, X);
 		}
+		const int X0 = MAX(int(ceil(X_left)), 0), X1 = MIN(int(floor(X_right)), src.cols - 1);
+		if (X1 < X0) continue;
+
+		const Mat Row = src(Rect(X0, y, X1 - X0 + 1, 1));
+		cvtColor(Row, Row_HSV, COLOR_BGR2HSV);
+		const uchar *BGR = Row.ptr<uchar>(0), *HSV = Row_HSV.ptr<uchar>(0);
+		for (int x = X0; x <= X1; x += step) {
+			const double Z = G(2, 0) * x + G(2, 1) * y + G(2, 2), Weight = fabs(Det / (Z * Z * Z));
+			const int k = 3 * (x - X0);
+			for (int c = 0; c < 3; ++c) {
+				//Same bins as calcHist on [0, 256)
+				Hists[c * HistBins + ((HSV[k + c] * HistBins) >> 8)] += Weight;
+				Hists[(c + 3) * HistBins + ((BGR[k + c] * HistBins) >> 8)] += Weight;
+			}
+			Sum_Weights += Weight;
+		}
+	}
+	if (Sum_Weights == 0.0) return;
+	for (double &Val : Hists) Val /= Sum_Weights;
+	store(Hists, HOG);
+}
+
+template <int HistBins, int HOGBins, typename Scalar>
+double Im_Features<HistBins, HOGBins, Scalar>::Distance(const Im_Features &features, const FeaturesCoefs &coefs) const
+{
+	double Res = sqrt(SquaredL2<HOGBins>(_HOG.data(), features._HOG.data())) * coefs[0], Coefs = coefs[0];
+	for (int i = 0; i < _HistoChans; ++i) {
+		const int idx = i * HistBins;
+		Res += sqrt(SquaredL2<HistBins>(&_Histograms[idx], &features._Histograms[idx])) * coefs[i + 1];
+		Coefs += coefs[i + 1];
 	}
 
-	double Res = 0.0, Coefs = 0.0;
-	for (int i = 0; i < _HistoChans + 1; ++i) {
-		Res += sqrt(Dists_Val[i]) * coefs[i];
-		Coefs += coefs[i];
+	return ((1 - ((Res / Scale() / Coefs) / sqrt(2))) * 100);
+}
+
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::ToRow(float row[_RowSize]) const
+{
+	for (int i = 0; i < HOGBins; ++i) row[i] = float(HOGValue(i));
+	for (int i = 0; i < _HistoChans * HistBins; ++i) row[HOGBins + i] = float(HistoValue(i));
+}
+
+bool NormalizedWeights(const FeaturesCoefs &coefs, float weights[7])
+{
+	double Coefs = 0.0;
+	for (const double Coef : coefs) Coefs += Coef;
+	if (Coefs <= 0.0) return false;
+	for (size_t c = 0; c < coefs.size(); ++c) weights[c] = float(coefs[c] / Coefs);
+	return true;
+}
+
+template <typename Features, typename Scalar>
+float RowsDistance(const Scalar *a, const Scalar *b, const float weights[7], const float bound)
+{
+	const int HOG = Features::_HOGBins, Bins = Features::_HistoBins;
+	float Dist = weights[0] != 0.0f ? weights[0] * sqrt(SquaredL2<HOG>(a, b)) : 0.0f;
+	for (int c = 0; c < Features::_HistoChans && Dist <= bound; ++c) {
+		if (weights[c + 1] == 0.0f) continue;
+		const int Offset = HOG + c * Bins;
+		Dist += weights[c + 1] * sqrt(SquaredL2<Bins>(a + Offset, b + Offset));
+	}
+	return Dist;
+}
+
+template <typename Features>
+void MatchTopK(const Features &query, const Mat &features, const int k, vector<int> &ids, vector<float> &dists,
+			   const FeaturesCoefs &coefs)
+{
+	ids.clear();
+	dists.clear();
+	if (k <= 0 || features.empty() || features.type() != CV_32FC1 || features.cols != Features::_RowSize) return;
+
+	//Normalised weights: the weighted norms add up to the distance, a partial sum is a lower bound of it
+	float Weights[Features::_HistoChans + 1];
+	if (!NormalizedWeights(coefs, Weights)) return;
+	float Query[Features::_RowSize];
+	query.ToRow(Query);
+
+	//Max-heap of the k best (distance, row), its top is the k-th one
+	vector<pair<float, int>> Heap;
+	Heap.reserve(k + 1);
+	float Worst = FLT_MAX;
+	auto Keep = [&](const float dist, const int r) {
+		if (dist >= Worst) return;
+		Heap.emplace_back(dist, r);
+		push_heap(Heap.begin(), Heap.end());
+		if (int(Heap.size()) > k) {
+			pop_heap(Heap.begin(), Heap.end());
+			Heap.pop_back();
+		}
+		if (int(Heap.size()) == k) Worst = Heap.front().first;
+	};
+	//Blocks of four rows against the query, the bound of a block is the k-th distance before it (it only decreases)
+	int r = 0;
+	for (; r <= features.rows - 4; r += 4) {
+		const float *const Rows[4] = {features.ptr<float>(r), features.ptr<float>(r + 1), features.ptr<float>(r + 2),
+									  features.ptr<float>(r + 3)};
+		float Dists[4];
+		RowsDistance4<Features>(Query, Rows, Weights, Worst, Dists);
+		for (int j = 0; j < 4; ++j) Keep(Dists[j], r + j);
 	}
+	for (; r < features.rows; ++r) Keep(RowsDistance<Features>(Query, features.ptr<float>(r), Weights, Worst), r);
 
-	return ((1 - ((Res / Coefs) / sqrt(2))) * 100);
+	sort_heap(Heap.begin(), Heap.end());
+	for (const pair<float, int> &Match : Heap) {
+		ids.push_back(Match.second);
+		dists.push_back(Match.first);
+	}
 }
 
-void Im_Features::ToCSV(const std::string &filename)
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::ToCSV(const std::string &filename) const
 {
 	ofstream myfile;
 	myfile.open(filename);
-	if (!_HOG.empty()) {
-		for (int i = 0; i < _HOG.size(); ++i) {
-			myfile << _HOG[i] << ";";
-		}
+	for (int i = 0; i < HOGBins; ++i) {
+		myfile << HOGValue(i) << ";";
 	}
 	myfile << "\n";
-	if (!_Histograms.empty()) {
-		for (int i = 0; i < _HistoChans; ++i) {
-			const int idx = i * _HistoBins;
-			for (int j = 0; j < _HistoBins; ++j) {
-				myfile << _Histograms[idx + j] << ";";
-			}
-			myfile << "\n";
+	for (int i = 0; i < _HistoChans; ++i) {
+		const int idx = i * HistBins;
+		for (int j = 0; j < HistBins; ++j) {
+			myfile << HistoValue(idx + j) << ";";
 		}
+		myfile << "\n";
 	}
 	myfile << "\n";
 	myfile.close();
 }
 
-void Im_Features::extractHistograms(const cv::Mat &image)
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::extractHistograms(const cv::Mat &image, double hists[_HistoChans * HistBins])
 {
 	const int Nb_Channels = 3;
 	const double Nb_Points = image.rows * image.cols;
 	const float Range[] = { 0, 256 };
 	const float* Hist_Range = { Range };
+	const int Bins = HistBins;
 	Mat HSV;
 	cvtColor(image, HSV, COLOR_BGR2HSV);
 	vector<Mat> BGRs(3), HSVs(3), Hists;
@@ -88,14 +568,14 @@ void Im_Features::extractHistograms(const cv::Mat &image)
 	split(HSV, HSVs);
 	Hists.resize(_HistoChans);
 	for (int i = 0; i < Nb_Channels; ++i) {
-		calcHist(&HSVs[i], 1, nullptr, Mat(), Hists[i], 1, &_HistoBins, &Hist_Range);
-		calcHist(&BGRs[i], 1, nullptr, Mat(), Hists[i + 3], 1, &_HistoBins, &Hist_Range);
+		calcHist(&HSVs[i], 1, nullptr, Mat(), Hists[i], 1, &Bins, &Hist_Range);
+		calcHist(&BGRs[i], 1, nullptr, Mat(), Hists[i + 3], 1, &Bins, &Hist_Range);
 	}
 
 	for(int i = 0; i < _HistoChans; ++i) {
-		int idx = i * _HistoBins;
+		int idx = i * HistBins;
 		for (auto it = Hists[i].begin<float>(); it != Hists[i].end<float>(); ++it) {
-			_Histograms[idx++] = *it / Nb_Points;
+			hists[idx++] = *it / Nb_Points;
 		}
 	}
 	BGRs.clear();
@@ -103,7 +583,8 @@ void Im_Features::extractHistograms(const cv::Mat &image)
 	Hists.clear();
 }
 
-void Im_Features::extractHOG(const cv::Mat &image)
+template <int HistBins, int HOGBins, typename Scalar>
+void Im_Features<HistBins, HOGBins, Scalar>::extractHOG(const cv::Mat &image, double hog[HOGBins])
 {
 	Mat Gray, Gx, Gy, Mag, Angle;
 	cvtColor(image, Gray, COLOR_BGR2GRAY);
@@ -114,7 +595,7 @@ void Im_Features::extractHOG(const cv::Mat &image)
 	// Calculate gradient magnitude and direction(in degrees)
 	cartToPolar(Gx, Gy, Mag, Angle, true);
 	// angle is in [0,360] 
-	const int Step = 360 / _HOGBins;
+	const int Step = 360 / HOGBins;
 
 	auto it_Mag = Mag.begin<float>(),	it_Angle = Angle.begin<float>();
 	const auto End = Mag.end<float>();
@@ -123,30 +604,31 @@ void Im_Features::extractHOG(const cv::Mat &image)
 		if (*it_Mag > 0.0) {
 			//Find the two bins to add magnitude
 			const float Bins_Range = *it_Angle / Step;
-			const int Idx = int(floor(Bins_Range));
-			float Ratio = Bins_Range - Idx;
+			//An angle rounded to 360 is in the first bin, the next of the last bin too
+			const int Bin = int(floor(Bins_Range)), Idx = Bin % HOGBins;
+			float Ratio = Bins_Range - Bin;
 			if (Ratio > 0.5) Ratio -= 0.5;
-			if (!(0 <= Idx && Idx < _HOGBins)) cout << "WTH : " << Idx<<endl;
-			_HOG[Idx] += Ratio * *it_Mag;
-			_HOG[(Idx==_HOGBins-1) ? 0: Idx + 1] += (1.0 - Ratio) * *it_Mag;
+			hog[Idx] += Ratio * *it_Mag;
+			hog[(Idx + 1) % HOGBins] += (1.0 - Ratio) * *it_Mag;
 			Sum_Mag += *it_Mag;
 		}
 	}
 
 	if (Sum_Mag != 0.0) {
-		for (int i = 0; i < _HOG.size(); ++i) {
-			_HOG[i] /= Sum_Mag;
+		for (int i = 0; i < HOGBins; ++i) {
+			hog[i] /= Sum_Mag;
 		}
 	}
 }
 
 
-std::ostream & operator<<(std::ostream &os, const Im_Features &obj)
+template <int H, int G, typename S>
+std::ostream & operator<<(std::ostream &os, const Im_Features<H, G, S> &obj)
 {
 	os << "HOG : [";
-	if (!obj._HOG.empty()) {
-		for (int i = 0; i < obj._HOG.size(); ++i) {
-			os << obj._HOG[i] << ", ";
+	if (G > 0) {
+		for (int i = 0; i < G; ++i) {
+			os << obj.HOGValue(i) << ", ";
 		}
 		os << "\b\b";
 	}
@@ -154,14 +636,12 @@ std::ostream & operator<<(std::ostream &os, const Im_Features &obj)
 
 	const vector<string> Name_Channels = { "H","S","V","B","G","R" };
 	for (int i = 0; i < obj._HistoChans; ++i) {
-		const int idx = i * obj._HistoBins;
+		const int idx = i * H;
 		os << "Histogramm " << Name_Channels[i] << " : [";
-		if (!obj._Histograms.empty()) {
-			for (int j = 0; j < obj._HistoBins; ++j) {
-				os << obj._Histograms[idx + j] << ", ";
-			}
-			os << "\b\b";
+		for (int j = 0; j < H; ++j) {
+			os << obj.HistoValue(idx + j) << ", ";
 		}
+		os << "\b\b";
 		os << "]" << endl;
 	}
 
@@ -170,3 +650,19 @@ std::ostream & operator<<(std::ostream &os, const Im_Features &obj)
 	return os;
 
 }
+
+//***** Layouts *****
+#define INSTANTIATE_FEATURES(H, G, S) \
+	template class Im_Features<H, G, S>; \
+	template std::ostream &operator <<(std::ostream &os, const Im_Features<H, G, S> &obj); \
+	template void MatchTopK(const Im_Features<H, G, S> &query, const Mat &features, int k, vector<int> &ids, \
+							vector<float> &dists, const FeaturesCoefs &coefs); \
+	template float RowsDistance<Im_Features<H, G, S>>(const float *a, const float *b, const float weights[7], float bound); \
+	template float RowsDistance<Im_Features<H, G, S>>(const uchar *a, const uchar *b, const float weights[7], float bound);
+
+INSTANTIATE_FEATURES(10, 10, float)
+INSTANTIATE_FEATURES(10, 10, ushort)
+INSTANTIATE_FEATURES(10, 10, uchar)
+INSTANTIATE_FEATURES(25, 10, float)
+INSTANTIATE_FEATURES(25, 10, ushort)
+INSTANTIATE_FEATURES(25, 10, uchar)
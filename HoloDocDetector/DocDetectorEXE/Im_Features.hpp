@@ -1,27 +1,91 @@
 #pragma once
 
 #include <opencv2/core.hpp>
+#include <array>
+#include <cfloat>
+#include <limits>
 
+//Weights of the distance: HOG, then the histograms H, S, V, B, G, R
+typedef std::array<double, 7> FeaturesCoefs;
+const FeaturesCoefs DEFAULT_FEATURES_COEFS = {0, 2, 1, 2, 1, 1, 1};
+//Weights of HoloDocServer (HIST_COEFS = [2, 2, 2, 1, 1, 1]), the server has no HOG
+const FeaturesCoefs SERVER_FEATURES_COEFS = {0, 2, 2, 2, 1, 1, 1};
+
+//Features of a document with its bin counts fixed at compile time
+//Scalar is the stored type: float, or uchar / ushort for values in [0, 1] quantised on the whole range of the type
+//Only the layouts instantiated in Im_Features.cpp are available (see DocFeatures and ServerFeatures)
+template <int HistBins, int HOGBins = 10, typename Scalar = float>
 class Im_Features
 {
+	//The HOG bins split the angles in equal steps of whole degrees (see extractHOG)
+	static_assert(HOGBins > 0 && 360 % HOGBins == 0, "HOGBins must divide 360");
+
 public:
-	const int _HistoChans = 6;
-	int _HistoBins,
-		_HOGBins;
-	std::vector<double> _Histograms;
-	std::vector<double> _HOG;
+	static const int _HistoChans = 6,
+					 _HistoBins = HistBins,
+					 _HOGBins = HOGBins,
+					 _RowSize = HOGBins + _HistoChans * HistBins;	// Floats of a row of a features matrix
+	std::array<Scalar, _HistoChans * HistBins> _Histograms;
+	std::array<Scalar, HOGBins> _HOG;
 
-	explicit Im_Features(int histo_bins = 10, int hog_bins = 10);
-	virtual ~Im_Features();
+	Im_Features();
 
-	void ExtractFeatures(const cv::Mat &image);
-	double Distance(const Im_Features &features, std::vector<double> coefs = {0,2,1,2,1,1,1});
+	//One read of the image: the six histograms and the HOG by bands of rows, no intermediate image
+	void ExtractFeatures(const cv::Mat &image, int nb_threads = 1);
+	//Former extraction with the OpenCV functions (HSV, split, calcHist, gray, Sobel, cartToPolar)
+	void ExtractFeaturesOpenCV(const cv::Mat &image);
+	//Histograms of the pixels inside a quad of the camera image, without rectifying it (the HOG is left empty)
+	//Each pixel is weighted by the area it covers on the rectified document, step samples one pixel out of step x step
+	void ExtractFeaturesInQuad(const cv::Mat &src, const std::vector<cv::Point> &quad, int step = 1);
+	//Similarity in [0, 100]: weighted mean of the L2 distances of the HOG and of each histogram (vectorised, unrolled on the bins)
+	double Distance(const Im_Features &features, const FeaturesCoefs &coefs = DefaultCoefs()) const;
+	//Weights of the layout: the server ones for its 25 bins (see ServerFeatures), the detector ones otherwise
+	static const FeaturesCoefs &DefaultCoefs() { return HistBins == 25 ? SERVER_FEATURES_COEFS : DEFAULT_FEATURES_COEFS; }
 
-	void ToCSV(const std::string &filename);
-	friend std::ostream &operator <<(std::ostream &os, const Im_Features &obj);
+	//Values in [0, 1] whatever the stored type
+	double HistoValue(int i) const { return _Histograms[i] / Scale(); }
+	double HOGValue(int i) const { return _HOG[i] / Scale(); }
+	static double Scale() { return std::numeric_limits<Scalar>::is_integer ? double((std::numeric_limits<Scalar>::max)()) : 1.0; }
+	//Row of a features matrix (see MatchTopK): the HOG then the histograms, values in [0, 1]
+	void ToRow(float row[_RowSize]) const;
+
+	void ToCSV(const std::string &filename) const;
+	template <int H, int G, typename S>
+	friend std::ostream &operator <<(std::ostream &os, const Im_Features<H, G, S> &obj);
 
 private:
-	void extractHistograms(const cv::Mat &image);
-	void extractHOG(const cv::Mat &image);
+	void extractHistograms(const cv::Mat &image, double hists[_HistoChans * HistBins]);
+	void extractHOG(const cv::Mat &image, double hog[HOGBins]);
+	//Stored (quantised) values
+	void store(const double hists[_HistoChans * HistBins], const double hog[HOGBins]);
 };
 
+template <int H, int G, typename S>
+std::ostream &operator <<(std::ostream &os, const Im_Features<H, G, S> &obj);
+
+//Weights of coefs divided by their sum (false if it isn't positive)
+bool NormalizedWeights(const FeaturesCoefs &coefs, float weights[7]);
+
+//Weighted mean of the L2 distances of the blocks (HOG, H, S, V, B, G, R) of two rows of Features (float rows or 8-bit codes)
+//weights are normalised, the sum stops as soon as it exceeds bound: a lower bound of the distance is returned
+template <typename Features, typename Scalar>
+float RowsDistance(const Scalar *a, const Scalar *b, const float weights[7], float bound = FLT_MAX);
+
+//The k rows of a features matrix (CV_32FC1, one ToRow of Features by row) the closest to the query, closest first
+//dists are the weighted means of the L2 distances of the blocks (HOG, H, S, V, B, G, R), Distance is (1 - dist / sqrt(2)) * 100
+//The rows are read four at a time against the query (one load of the query for four rows, four sums in registers),
+//a block is abandoned as soon as the partial distances of its four rows exceed the current k-th one
+template <typename Features>
+void MatchTopK(const Features &query, const cv::Mat &features, int k, std::vector<int> &ids, std::vector<float> &dists,
+			   const FeaturesCoefs &coefs = Features::DefaultCoefs());
+
+//Layout of the detector (10 bins)
+typedef Im_Features<10, 10, float> DocFeatures;
+typedef Im_Features<10, 10, ushort> DocFeatures16;
+typedef Im_Features<10, 10, uchar> DocFeatures8;
+//Layout of HoloDocServer (HIST_BINS = 25, weights SERVER_FEATURES_COEFS)
+//improc-recognition.js computes no HOG: the 10 HOG values stay in the records and rows (ToRow, _RowSize) for the common
+//layout of the template, with a weight of 0 they don't change the distance
+typedef Im_Features<25, 10, float> ServerFeatures;
+typedef Im_Features<25, 10, ushort> ServerFeatures16;
+typedef Im_Features<25, 10, uchar> ServerFeatures8;
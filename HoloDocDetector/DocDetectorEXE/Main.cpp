@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <conio.h>	// _getch
 #include <cstdlib>
@@ -5,14 +6,24 @@
 #include <iostream>
 #include <fstream>
 #include "DocDetector.hpp"
+#include "Kernels.hpp"
+#include "AsyncDetector.hpp"
+#include "ThreadPool.hpp"
 #include "Misc.hpp"
 #include "Contours.hpp"
+#include "LinesQuads.hpp"
 #include "Im_Features.hpp"
+#include "FeaturesIndex.hpp"
+#include "FeaturesPQ.hpp"
+#include "MatchCascade.hpp"
 
 
 #include <set>
+#include <random>
+#include <algorithm>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/imgproc/imgproc_c.h>
 
 using namespace std;
 using namespace std::chrono;
@@ -26,9 +37,10 @@ const vector<string> NAMES = {"A", "B", "C", "D", "E", "F", "G", "H", "I"};
 const string EXT = ".jpg";
 const vector<string> EDGE_TIMES_NAMES = { 
 	"Read", "Gray", "Blur", 
-	"Bilateral", "Adaptative Mean", "Adaptative Gaussian",
+	"Bilateral", "Guided", "Adaptative Mean", "Adaptative Gaussian",
 	"Background Tresh", "Adaptative on Bg Tresh", "Canny on Gray",
-	"Canny on Blur", "Canny on Bilateral", "Canny on Bg Tresh" 
+	"Canny on Blur", "Canny on Bilateral", "Canny on Guided", "Canny on Bg Tresh",
+	"Guided edges near Bilateral edges (%)", "Bilateral edges near Guided edges (%)"
 };
 
 const vector<string> CONT_SRC = {"NBC", "BT", "BTA"};
@@ -50,24 +62,187 @@ const vector<string> CONT_TIMES_NAMES = {
 	"Last Clean (C12->C13)"
 };
 
+const vector<string> SESSION_TIMES_NAMES = {
+	"Detection without Session (ms)", "Detection with Session (ms)",
+	"Allocations per frame without Session", "Allocations per frame with Session"
+};
+
+const vector<string> MASK_TIMES_NAMES = {
+	"Conversion + inRange (ms)", "Background Mask (ms)", "Speedup", "Different pixels"
+};
+
+const vector<string> PYRAMID_TIMES_NAMES = {
+	"Level 0 (ms)", "Level 1 (ms)", "Level 2 (ms)", "Level 3 (ms)",
+	"Speedup Level 1", "Speedup Level 2", "Speedup Level 3",
+	"Mean corner error Level 1 (px)", "Mean corner error Level 2 (px)", "Mean corner error Level 3 (px)",
+	"Max corner error Level 1 (px)", "Max corner error Level 2 (px)", "Max corner error Level 3 (px)",
+	"Nb Docs Level 0", "Nb Docs Level 1", "Nb Docs Level 2", "Nb Docs Level 3"
+};
+
+const vector<string> TRACK_TIMES_NAMES = {
+	"Detection (ms)", "Tracking (ms)", "Speedup", "Full detections",
+	"Mean corner error (px)", "Max corner error (px)"
+};
+
+const vector<int> CLUTTER_LEVELS = {0, 2000, 10000, 40000};
+const vector<string> CLUTTER_TIMES_NAMES = {
+	"Contours 0 blobs", "Prototype 0 blobs (ms)", "Prototype ContourSet 0 blobs (ms)", "Session 0 blobs (ms)",
+	"Contours 2000 blobs", "Prototype 2000 blobs (ms)", "Prototype ContourSet 2000 blobs (ms)", "Session 2000 blobs (ms)",
+	"Contours 10000 blobs", "Prototype 10000 blobs (ms)", "Prototype ContourSet 10000 blobs (ms)", "Session 10000 blobs (ms)",
+	"Contours 40000 blobs", "Prototype 40000 blobs (ms)", "Prototype ContourSet 40000 blobs (ms)", "Session 40000 blobs (ms)"
+};
+
+const vector<string> CORNERS_TIMES_NAMES = {
+	"Contours points", "Extract 4 Corners vector (ms)", "Extract 4 Corners ContourSet (ms)", "Speedup", "Different quads",
+	"Hulls + Approxs + Extract 4 Corners ContourSet (ms)", "Hull Quads ContourSet (ms)", "Hull Quads speedup", "Hull Quads quads"
+};
+
+const vector<string> FUSED_EDGE_TIMES_NAMES = {
+	"Conversion + BinaryEdgeDetector (ms)", "Edge Map (ms)", "Speedup", "Different pixels"
+};
+
+const vector<string> RECTIFY_TIMES_NAMES = {
+	"Document pixels", "Perspective transform + warpPerspective (ms)", "Rectifier first frame (ms)",
+	"Rectifier still quad (ms)", "Speedup", "Mean difference", "Rectifier 512 still quad (ms)", "Speedup 512"
+};
+
+const vector<string> QUAD_FEATURES_TIMES_NAMES = {
+	"Extraction + Features (ms)", "Features in Quad (ms)", "Speedup", "Histograms difference (L1)",
+	"Features in Quad step 2 (ms)", "Speedup step 2", "Histograms difference step 2 (L1)"
+};
+
+const vector<string> FEATURES_TIMES_NAMES = {
+	"OpenCV features (ms)", "Fused features (ms)", "Speedup", "Fused features 4 threads (ms)", "Speedup 4 threads",
+	"Histograms difference (L1)", "HOG difference (L1)"
+};
+
+const vector<string> TABLE_TIMES_NAMES = {
+	"Conversion + inRange (ms)", "Color table (ms)", "Speedup", "Different pixels", "Learned border background (%)"
+};
+
+const vector<string> ASYNC_TIMES_NAMES = {
+	"Synchronous frame (ms)", "Asynchronous frame (ms)",
+	"Main thread blocked synchronous (ms)", "Main thread blocked asynchronous (ms)",
+	"Results", "Dropped frames"
+};
+
 
 //*******************
 //***** VECTORS *****
 //*******************
 vector<vector<double>> EdgeDuration;
 vector<vector<double>> ContourDuration;
+vector<vector<double>> SessionDuration;
+vector<vector<double>> MaskDuration;
+vector<vector<double>> PyramidDuration;
+vector<vector<double>> TrackDuration;
+vector<vector<double>> AsyncDuration;
+vector<vector<double>> ClutterDuration;
+vector<vector<double>> CornersDuration;
+vector<vector<double>> TableDuration;
+vector<vector<double>> FusedEdgeDuration;
+vector<vector<double>> RectifyDuration;
+vector<vector<double>> QuadFeaturesDuration;
+vector<vector<double>> FeaturesDuration;
 
 void InitVector(int k)
 {
 	EdgeDuration.resize(k);
 	ContourDuration.resize(k);
+	SessionDuration.resize(k);
+	MaskDuration.resize(k);
+	PyramidDuration.resize(k);
+	TrackDuration.resize(k);
+	AsyncDuration.resize(k);
+	ClutterDuration.resize(k);
+	CornersDuration.resize(k);
+	TableDuration.resize(k);
+	FusedEdgeDuration.resize(k);
+	RectifyDuration.resize(k);
+	QuadFeaturesDuration.resize(k);
+	FeaturesDuration.resize(k);
 
 	for (int i = 0; i < k; ++i) {
 		EdgeDuration[i].resize(EDGE_TIMES_NAMES.size());
 		ContourDuration[i].resize(CONT_TIMES_NAMES.size()*3);
+		SessionDuration[i].resize(SESSION_TIMES_NAMES.size());
+		MaskDuration[i].resize(MASK_TIMES_NAMES.size());
+		PyramidDuration[i].resize(PYRAMID_TIMES_NAMES.size());
+		TrackDuration[i].resize(TRACK_TIMES_NAMES.size());
+		AsyncDuration[i].resize(ASYNC_TIMES_NAMES.size());
+		ClutterDuration[i].resize(CLUTTER_TIMES_NAMES.size());
+		CornersDuration[i].resize(CORNERS_TIMES_NAMES.size());
+		TableDuration[i].resize(TABLE_TIMES_NAMES.size());
+		FusedEdgeDuration[i].resize(FUSED_EDGE_TIMES_NAMES.size());
+		RectifyDuration[i].resize(RECTIFY_TIMES_NAMES.size());
+		QuadFeaturesDuration[i].resize(QUAD_FEATURES_TIMES_NAMES.size());
+		FeaturesDuration[i].resize(FEATURES_TIMES_NAMES.size());
+	}
+}
+
+// One row per step, one column per image
+void SaveStepsCSV(const string &filename, const vector<string> &steps, const vector<vector<double>> &values, int k)
+{
+	ofstream File;
+	cout << "Save " << filename << "...";
+	File.open(PATH + filename);
+	File << "Step";
+	for (int i = 0; i < k; ++i) {
+		File << ";" << NAMES[i];
 	}
+	File << "\n";
+
+	for (size_t j = 0; j < steps.size(); ++j) {
+		File << steps[j];
+		for (int i = 0; i < k; ++i) {
+			File << ";" << values[i][j];
+		}
+		File << "\n";
+	}
+	File.close();
+	cout << " Done" << endl;
+}
+
+//*******************************
+//***** ALLOCATIONS COUNTER *****
+//*******************************
+// Counts the std containers allocated by this executable (DocDetector.cpp is compiled in it)
+// and every cv::Mat buffer (through the default Mat allocator), OpenCV internal buffers are not counted.
+// Only the allocations made while Counting_allocations is set are counted (the measured section of TestsSession),
+// by any thread: with nbThreads > 1 the threads of the pool (see ParallelFor) are created by the first frame without Session,
+// they don't allocate after.
+atomic<bool> Counting_allocations(false);
+atomic<size_t> Nb_allocations(0);
+
+void *operator new(size_t size)
+{
+	if (Counting_allocations) Nb_allocations++;
+	void *p = malloc(size == 0 ? 1 : size);
+	if (p == nullptr) throw bad_alloc();
+	return p;
 }
 
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+class CountingAllocator : public MatAllocator
+{
+public:
+	UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+					   int flags, UMatUsageFlags usageFlags) const override
+	{
+		if (Counting_allocations) Nb_allocations++;
+		return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+	}
+
+	bool allocate(UMatData *data, int accessflags, UMatUsageFlags usageFlags) const override
+	{
+		return Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+	}
+
+	void deallocate(UMatData *data) const override { Mat::getStdAllocator()->deallocate(data); }
+};
+
 void SaveCSV(int k)
 {
 	ofstream EdgeFile, ContourFile;
@@ -110,6 +285,18 @@ void SaveCSV(int k)
 	ContourFile.close();
 	cout << " Done" << endl;
 
+	SaveStepsCSV("SessionDuration.csv", SESSION_TIMES_NAMES, SessionDuration, k);
+	SaveStepsCSV("MaskDuration.csv", MASK_TIMES_NAMES, MaskDuration, k);
+	SaveStepsCSV("PyramidDuration.csv", PYRAMID_TIMES_NAMES, PyramidDuration, k);
+	SaveStepsCSV("TrackDuration.csv", TRACK_TIMES_NAMES, TrackDuration, k);
+	SaveStepsCSV("AsyncDuration.csv", ASYNC_TIMES_NAMES, AsyncDuration, k);
+	SaveStepsCSV("ClutterDuration.csv", CLUTTER_TIMES_NAMES, ClutterDuration, k);
+	SaveStepsCSV("CornersDuration.csv", CORNERS_TIMES_NAMES, CornersDuration, k);
+	SaveStepsCSV("TableDuration.csv", TABLE_TIMES_NAMES, TableDuration, k);
+	SaveStepsCSV("FusedEdgeDuration.csv", FUSED_EDGE_TIMES_NAMES, FusedEdgeDuration, k);
+	SaveStepsCSV("RectifyDuration.csv", RECTIFY_TIMES_NAMES, RectifyDuration, k);
+	SaveStepsCSV("QuadFeaturesDuration.csv", QUAD_FEATURES_TIMES_NAMES, QuadFeaturesDuration, k);
+	SaveStepsCSV("FeaturesDuration.csv", FEATURES_TIMES_NAMES, FeaturesDuration, k);
 }
 
 //*****************
@@ -120,9 +307,9 @@ void TestsEdge(const int i = 0)
 	cout << "===================================" << endl;
 	cout << "===== Test Edge Image " << NAMES[i] << " Begin =====" << endl;
 
-	Mat Im_gray_scale, Im_blur, Im_bilateral, Im_bg_tresh,
+	Mat Im_gray_scale, Im_blur, Im_bilateral, Im_guided, Im_bg_tresh,
 		Im_adapt_mean, Im_adapt_gauss, Im_adapt_mean_bg_tresh,
-		Im_canny_gray, Im_canny_blur, Im_canny_bilateral, Im_canny_bg_tresh;
+		Im_canny_gray, Im_canny_blur, Im_canny_bilateral, Im_canny_guided, Im_canny_bg_tresh;
 
 	int j = 0;
 
@@ -151,6 +338,12 @@ void TestsEdge(const int i = 0)
 	EdgeDuration[i][j] = Fp_ms.count();
 	cout << "Time Bilateral : \t\t" << EdgeDuration[i][j++] << " ms" << endl;
 
+	T1 = high_resolution_clock::now();
+	GuidedFilter(Im_gray_scale, Im_guided);
+	Fp_ms = high_resolution_clock::now() - T1;
+	EdgeDuration[i][j] = Fp_ms.count();
+	cout << "Time Guided : \t\t\t" << EdgeDuration[i][j++] << " ms" << endl;
+
 	T1 = high_resolution_clock::now();
 	adaptiveThreshold(Im_gray_scale, Im_adapt_mean, 255, CV_ADAPTIVE_THRESH_MEAN_C, CV_THRESH_BINARY, 5, 4);
 	bitwise_not(Im_adapt_mean, Im_adapt_mean);
@@ -197,11 +390,26 @@ void TestsEdge(const int i = 0)
 	EdgeDuration[i][j] = Fp_ms.count();
 	cout << "Time Canny on Bilateral : \t" << EdgeDuration[i][j++] << " ms" << endl;
 
+	T1 = high_resolution_clock::now();
+	Canny(Im_guided, Im_canny_guided, 50, 205, 3);
+	Fp_ms = high_resolution_clock::now() - T1;
+	EdgeDuration[i][j] = Fp_ms.count();
+	cout << "Time Canny on Guided : \t\t" << EdgeDuration[i][j++] << " ms" << endl;
+
 	T1 = high_resolution_clock::now();
 	Canny(Im_bg_tresh, Im_canny_bg_tresh, 50, 205, 3);
 	Fp_ms = high_resolution_clock::now() - T1;
 	EdgeDuration[i][j] = Fp_ms.count();
-	cout << "Time Canny on Bg Tresh : \t" << EdgeDuration[i][j] << " ms" << endl;
+	cout << "Time Canny on Bg Tresh : \t" << EdgeDuration[i][j++] << " ms" << endl;
+
+	//Edges of one map at most one pixel away from the edges of the other
+	Mat Near_bilateral, Near_guided;
+	dilate(Im_canny_bilateral, Near_bilateral, Mat());
+	dilate(Im_canny_guided, Near_guided, Mat());
+	EdgeDuration[i][j] = 100.0 * countNonZero(Im_canny_guided & Near_bilateral) / MAX(1, countNonZero(Im_canny_guided));
+	cout << "Guided near Bilateral : \t" << EdgeDuration[i][j++] << " %" << endl;
+	EdgeDuration[i][j] = 100.0 * countNonZero(Im_canny_bilateral & Near_guided) / MAX(1, countNonZero(Im_canny_bilateral));
+	cout << "Bilateral near Guided : \t" << EdgeDuration[i][j] << " %" << endl;
 
 
 	//***** Save *****
@@ -210,6 +418,7 @@ void TestsEdge(const int i = 0)
 	imwrite(Path + NAMES[i] + "_Gray" + EXT, Im_gray_scale);
 	imwrite(Path + NAMES[i] + "_Blur" + EXT, Im_blur);
 	imwrite(Path + NAMES[i] + "_Bilat" + EXT, Im_bilateral);
+	imwrite(Path + NAMES[i] + "_Guided" + EXT, Im_guided);
 	imwrite(Path + NAMES[i] + "_AdaptM" + EXT, Im_adapt_mean);
 	imwrite(Path + NAMES[i] + "_AdaptG" + EXT, Im_adapt_gauss);
 	imwrite(Path + NAMES[i] + "_Background_Tresh" + EXT, Im_bg_tresh);
@@ -217,6 +426,7 @@ void TestsEdge(const int i = 0)
 	imwrite(Path + NAMES[i] + "_Canny_Gray" + EXT, Im_canny_gray);
 	imwrite(Path + NAMES[i] + "_Canny_Blur" + EXT, Im_canny_blur);
 	imwrite(Path + NAMES[i] + "_Canny_Bilat" + EXT, Im_canny_bilateral);
+	imwrite(Path + NAMES[i] + "_Canny_Guided" + EXT, Im_canny_guided);
 	imwrite(Path + NAMES[i] + "_Canny_Bg_Tresh" + EXT, Im_canny_bg_tresh);
 	cout << "Done" << endl;
 
@@ -526,11 +736,1685 @@ int TestsDLLFunction(const int i = 0)
 	return NO_ERRORS;
 }
 
+//Allocations per frame of every thread (the workers of the pool with nb_threads > 1)
+void TestsSession(const int i = 0, const int nb_threads = 1)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Session Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30, Max_docs = 256;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Unity like frame
+	Mat Rgba;
+	cvtColor(Src, Rgba, CV_BGR2RGBA);
+	Color32 *Frame = reinterpret_cast<Color32 *>(Rgba.data);
+	const uint W = Src.cols, H = Src.rows;
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	Params.nbThreads = nb_threads;
+	vector<int> Points(8 * Max_docs);
+	uint Nb_docs[2] = {0, 0};
+
+	CountingAllocator Counter;
+	MatAllocator *Default_allocator = Mat::getDefaultAllocator();
+	Mat::setDefaultAllocator(&Counter);
+	int j = 0;
+
+	//Without Session
+	Nb_allocations = 0;
+	Counting_allocations = true;
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		DocsDetection(Frame, W, H, Params.background, &Nb_docs[0], Points.data());
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	Counting_allocations = false;
+	const size_t Allocations_without = Nb_allocations;
+	SessionDuration[i][j] = Fp_ms.count() / Nb_frames;
+	cout << "Time without Session : \t" << SessionDuration[i][j++] << " ms" << endl;
+
+	//With Session (first frame warms the buffers up)
+	DetectorSession *Session = nullptr;
+	CreateDetectorSession(W, H, Params, &Session);
+	SessionDocsDetection(Session, Frame, W, H, &Nb_docs[1], Points.data());
+	Nb_allocations = 0;
+	Counting_allocations = true;
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		SessionDocsDetection(Session, Frame, W, H, &Nb_docs[1], Points.data());
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	Counting_allocations = false;
+	const size_t Allocations_with = Nb_allocations;
+	DestroyDetectorSession(Session);
+	Mat::setDefaultAllocator(Default_allocator);
+	SessionDuration[i][j] = Fp_ms.count() / Nb_frames;
+	cout << "Time with Session : \t\t" << SessionDuration[i][j++] << " ms" << endl;
+
+	SessionDuration[i][j] = double(Allocations_without) / Nb_frames;
+	cout << "Allocations without Session : \t" << SessionDuration[i][j++] << " per frame" << endl;
+	SessionDuration[i][j] = double(Allocations_with) / Nb_frames;
+	cout << "Allocations with Session : \t" << SessionDuration[i][j] << " per frame" << endl;
+	cout << "Nb Docs : \t\t\t" << Nb_docs[0] << " / " << Nb_docs[1] << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsMask(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Mask Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Unity like frame
+	Mat Rgba, Bgr, Mask[2];
+	cvtColor(Src, Rgba, CV_BGR2RGBA);
+	const Color32 *Frame = reinterpret_cast<const Color32 *>(Rgba.data);
+	const uint W = Src.cols, H = Src.rows;
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	const DetectorSession Session(W, H, Params);	// Only for the background color range
+	const Scalar &Lower = Session._Lower, &Higher = Session._Higher;
+	int j = 0;
+
+	//Conversion + inRange
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		cvtColor(Mat(H, W, CV_8UC4, const_cast<Color32 *>(Frame)), Bgr, CV_RGBA2BGR);
+		inRange(Bgr, Lower, Higher, Mask[0]);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	MaskDuration[i][j] = Fp_ms.count() / Nb_frames;
+	cout << "Time Conversion + inRange : 	" << MaskDuration[i][j++] << " ms" << endl;
+
+	//Fused kernel
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		BackgroundMask(Frame, W, H, Lower, Higher, Mask[1]);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	MaskDuration[i][j] = Fp_ms.count() / Nb_frames;
+	cout << "Time Background Mask : 		" << MaskDuration[i][j++] << " ms" << endl;
+
+	MaskDuration[i][j] = MaskDuration[i][0] / MaskDuration[i][1];
+	cout << "Speedup : 			" << MaskDuration[i][j++] << endl;
+	MaskDuration[i][j] = countNonZero(Mask[0] != Mask[1]);
+	cout << "Different pixels : 		" << MaskDuration[i][j] << endl;
+	cout << "======================================" << endl << endl;
+}
+
+/// <summary>Corner error of docs against reference docs (nearest doc, then nearest corner).</summary>
+void CornerError(const vector<vector<Point>> &ref, const vector<vector<Point>> &docs, double &sum, double &max, int &nb)
+{
+	for (const vector<Point> &Ref : ref) {
+		if (docs.empty()) break;
+		const Point Center = GetCenter(Ref);
+		const vector<Point> *Nearest = &docs[0];
+		for (const vector<Point> &Doc : docs) {
+			if (SquaredDist(GetCenter(Doc), Center) < SquaredDist(GetCenter(*Nearest), Center)) Nearest = &Doc;
+		}
+		for (const Point &P : Ref) {
+			double Error = Dist(P, (*Nearest)[0]);
+			for (const Point &Q : *Nearest) Error = MIN(Error, Dist(P, Q));
+			sum += Error;
+			max = MAX(max, Error);
+			nb++;
+		}
+	}
+}
+
+void TestsPyramid(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Pyramid Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30, Nb_levels = 4;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Unity like frame
+	Mat Rgba;
+	cvtColor(Src, Rgba, CV_BGR2RGBA);
+	Color32 *Frame = reinterpret_cast<Color32 *>(Rgba.data);
+	const uint W = Src.cols, H = Src.rows;
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	vector<vector<Point>> Docs[Nb_levels];
+
+	for (int l = 0; l < Nb_levels; ++l) {
+		Params.pyramidLevel = l;
+		DetectorSession Session(W, H, Params);
+		DocsDetection(Session, Frame, W, H);
+		const auto T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) {
+			DocsDetection(Session, Frame, W, H);
+		}
+		const duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+		Docs[l].assign(Session._Contours.begin(), Session._Contours.begin() + Session._Nb_contours);
+		PyramidDuration[i][l] = Fp_ms.count() / Nb_frames;
+		PyramidDuration[i][13 + l] = double(Docs[l].size());
+		cout << "Time Level " << l << " : \t\t" << PyramidDuration[i][l] << " ms (" << Docs[l].size() << " docs)" << endl;
+	}
+
+	//Corner error against the full resolution detection
+	for (int l = 1; l < Nb_levels; ++l) {
+		double Sum = 0.0, Max = 0.0;
+		int Nb = 0;
+		CornerError(Docs[0], Docs[l], Sum, Max, Nb);
+		PyramidDuration[i][3 + l] = PyramidDuration[i][0] / PyramidDuration[i][l];
+		PyramidDuration[i][6 + l] = Nb > 0 ? Sum / Nb : 0.0;
+		PyramidDuration[i][9 + l] = Max;
+		cout << "Level " << l << " : \tSpeedup " << PyramidDuration[i][3 + l]
+			<< "\tMean corner error " << PyramidDuration[i][6 + l] << " px"
+			<< "\tMax corner error " << Max << " px" << endl;
+	}
+	cout << "======================================" << endl << endl;
+}
+
+void TestsTracking(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Tracking Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 60, Amplitude = 16;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols <= 2 * Amplitude || Src.rows <= 2 * Amplitude) { return; }
+
+	//Unity like sequence: a window moving slowly on the image (like a head in front of a desk)
+	const uint W = Src.cols - 2 * Amplitude, H = Src.rows - 2 * Amplitude;
+	vector<Mat> Frames(Nb_frames);
+	for (int f = 0; f < Nb_frames; ++f) {
+		const double Angle = 2 * CV_PI * f / Nb_frames;
+		const Rect Window(Amplitude + cvRound(Amplitude * cos(Angle)), Amplitude + cvRound(Amplitude * sin(Angle)), W, H);
+		cvtColor(Src(Window), Frames[f], CV_BGR2RGBA);
+	}
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	DetectorSession Detection(W, H, Params), Tracking(W, H, Params);
+	vector<vector<vector<Point>>> Docs(Nb_frames);
+	int j = 0;
+
+	//Full detection on each frame
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		DocsDetection(Detection, reinterpret_cast<Color32 *>(Frames[f].data), W, H);
+		Docs[f].assign(Detection._Contours.begin(), Detection._Contours.begin() + Detection._Nb_contours);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	TrackDuration[i][j] = Fp_ms.count() / Nb_frames;
+	cout << "Time Detection : \t\t" << TrackDuration[i][j++] << " ms" << endl;
+
+	//Tracking (corner error against the detection of the same frame)
+	double Sum = 0.0, Max = 0.0, Time = 0.0;
+	int Nb = 0, Nb_detections = 0;
+	for (int f = 0; f < Nb_frames; ++f) {
+		T1 = high_resolution_clock::now();
+		TrackDocs(Tracking, reinterpret_cast<Color32 *>(Frames[f].data), W, H);
+		Fp_ms = high_resolution_clock::now() - T1;
+		Time += Fp_ms.count();
+		if (Tracking._Tracked_frames == 0) Nb_detections++;
+		const vector<vector<Point>> Tracked(Tracking._Contours.begin(), Tracking._Contours.begin() + Tracking._Nb_contours);
+		CornerError(Docs[f], Tracked, Sum, Max, Nb);
+	}
+	TrackDuration[i][j] = Time / Nb_frames;
+	cout << "Time Tracking : \t\t" << TrackDuration[i][j++] << " ms" << endl;
+	TrackDuration[i][j] = TrackDuration[i][0] / TrackDuration[i][1];
+	cout << "Speedup : \t\t\t" << TrackDuration[i][j++] << endl;
+	TrackDuration[i][j++] = Nb_detections;
+	cout << "Full detections : \t\t" << Nb_detections << " / " << Nb_frames << endl;
+	TrackDuration[i][j] = Nb > 0 ? Sum / Nb : 0.0;
+	cout << "Mean corner error : \t\t" << TrackDuration[i][j++] << " px" << endl;
+	TrackDuration[i][j] = Max;
+	cout << "Max corner error : \t\t" << Max << " px" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsAsync(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Async Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 60, Max_docs = 256;
+	const milliseconds Render(10);	// Capture and rendering work of Unity on each frame
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Unity like frame
+	Mat Rgba;
+	cvtColor(Src, Rgba, CV_BGR2RGBA);
+	Color32 *Frame = reinterpret_cast<Color32 *>(Rgba.data);
+	const uint W = Src.cols, H = Src.rows;
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	Params.trackingPeriod = 0;		// Same work on both sides
+	vector<int> Points(8 * Max_docs);
+	uint Nb_docs = 0;
+
+	//Synchronous: the detection blocks the main thread
+	DetectorSession *Session = nullptr;
+	CreateDetectorSession(W, H, Params, &Session);
+	double Blocked = 0.0;
+	auto T0 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		const auto T1 = high_resolution_clock::now();
+		SessionDocsDetection(Session, Frame, W, H, &Nb_docs, Points.data());
+		const duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+		Blocked += Fp_ms.count();
+		this_thread::sleep_for(Render);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T0;
+	DestroyDetectorSession(Session);
+	AsyncDuration[i][0] = Fp_ms.count() / Nb_frames;
+	AsyncDuration[i][2] = Blocked / Nb_frames;
+
+	//Asynchronous: submit, render, poll
+	AsyncDetector *Detector = nullptr;
+	CreateAsyncDetector(W, H, Params, &Detector);
+	int Nb_results = 0, Id = -1;
+	Blocked = 0.0;
+	T0 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		const auto T1 = high_resolution_clock::now();
+		SubmitFrame(Detector, Frame, W, H, f);
+		if (TryGetResult(Detector, &Id, &Nb_docs, Points.data()) != NO_RESULT) Nb_results++;
+		const duration<double, std::milli> Blocked_ms = high_resolution_clock::now() - T1;
+		Blocked += Blocked_ms.count();
+		this_thread::sleep_for(Render);
+	}
+	Fp_ms = high_resolution_clock::now() - T0;
+	const int Nb_dropped = Detector->_Nb_dropped;
+	DestroyAsyncDetector(Detector);
+	AsyncDuration[i][1] = Fp_ms.count() / Nb_frames;
+	AsyncDuration[i][3] = Blocked / Nb_frames;
+	AsyncDuration[i][4] = Nb_results;
+	AsyncDuration[i][5] = Nb_dropped;
+
+	cout << "Frame Synchronous : \t\t" << AsyncDuration[i][0] << " ms (blocked " << AsyncDuration[i][2] << " ms)" << endl;
+	cout << "Frame Asynchronous : \t\t" << AsyncDuration[i][1] << " ms (blocked " << AsyncDuration[i][3] << " ms)" << endl;
+	cout << "Results : \t\t\t" << Nb_results << " / " << Nb_frames << " (" << Nb_dropped << " dropped)" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsClutter(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Clutter Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 10;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+	const double Length_min = 0.2 * (Src.cols + Src.rows),
+				 Length_max = 1.4 * (Src.cols + Src.rows),
+				 Center_dist_min = 0.05 * SquaredDist(Point(Src.cols, Src.rows));
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	DetectorSession Session(Src.cols, Src.rows, Params);
+	CvMemStorage *Storage = cvCreateMemStorage();
+	int j = 0;
+
+	for (const int Nb_blobs : CLUTTER_LEVELS) {
+		//Small blobs of background on the documents and of documents on the background (thousands of tiny contours)
+		Mat Clutter = Src.clone();
+		RNG Rng(Nb_blobs);
+		for (int b = 0; b < Nb_blobs; ++b) {
+			const Point P(Rng.uniform(0, Src.cols), Rng.uniform(0, Src.rows));
+			const Point Size(Rng.uniform(2, 10), Rng.uniform(2, 10));
+			rectangle(Clutter, P, P + Size, b % 2 ? COLORS[0] : COLORS[2], CV_FILLED);
+		}
+
+		//Prototype (Contours.cpp, one vector and erase by step)
+		Mat Binary;
+		vector<vector<Point>> Steps[4];
+		auto T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) {
+			inRange(Clutter, Scalar(0, 0, 0), Scalar(50, 50, 50), Binary);
+			findContours(Binary, Steps[0], CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+			CleanBasic(Steps[0], Steps[1], Length_min, Length_max);
+			Extract4Corners(Steps[1], Steps[2], Length_min, Length_max);
+			FinalClean(Steps[2], Steps[3], Length_min, Length_max, Center_dist_min);
+		}
+		duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+		ClutterDuration[i][j++] = double(Steps[0].size());
+		ClutterDuration[i][j++] = Fp_ms.count() / Nb_frames;
+
+		//Same prototype on ContourSet arenas (stages filter index lists)
+		ContourSet Raw, Quads;
+		vector<int> Ids;
+		T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) {
+			inRange(Clutter, Scalar(0, 0, 0), Scalar(50, 50, 50), Binary);
+			CvMat C_binary = Binary;
+			CvSeq *First = nullptr;
+			cvClearMemStorage(Storage);
+			cvFindContours(&C_binary, Storage, &First, sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+			Raw.Clear();
+			for (CvSeq *Seq = First; Seq != nullptr; Seq = Seq->h_next) Raw.Add(Seq);
+			Ids.resize(Raw.Size());
+			for (int k = 0; k < Raw.Size(); ++k) Ids[k] = k;
+			CleanBasic(Raw, Ids, Length_min, Length_max);
+			Extract4Corners(Raw, Ids, Quads, Length_min, Length_max);
+			FinalClean(Quads, Ids, Length_min, Length_max, Center_dist_min);
+		}
+		Fp_ms = high_resolution_clock::now() - T1;
+		ClutterDuration[i][j++] = Fp_ms.count() / Nb_frames;
+
+		//Session (candidates records, one pass)
+		vector<vector<Point>> Docs;
+		T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) {
+			DocsDetection(Session, Clutter, Docs);
+		}
+		Fp_ms = high_resolution_clock::now() - T1;
+		ClutterDuration[i][j++] = Fp_ms.count() / Nb_frames;
+		cout << Nb_blobs << " blobs (" << Steps[0].size() << " contours) : \tPrototype " << ClutterDuration[i][j - 3]
+			<< " ms\tContourSet " << ClutterDuration[i][j - 2] << " ms\tSession " << ClutterDuration[i][j - 1]
+			<< " ms\tDocs " << Steps[3].size() << " / " << Ids.size() << " / " << Docs.size() << endl;
+	}
+	cvReleaseMemStorage(&Storage);
+	cout << "======================================" << endl << endl;
+}
+
+void TestsCorners(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Corners Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 50;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+	const double Length_min = 0.2 * (Src.cols + Src.rows),
+				 Length_max = 1.4 * (Src.cols + Src.rows);
+
+	//Long contours: every border pixel is kept
+	Mat Binary;
+	vector<vector<Point>> Contours, Cleaned, Quads;
+	inRange(Src, Scalar(0, 0, 0), Scalar(50, 50, 50), Binary);
+	findContours(Binary, Contours, CV_RETR_LIST, CV_CHAIN_APPROX_NONE);
+	CleanBasic(Contours, Cleaned, Length_min, Length_max);
+	ContourSet Raw, Set_quads;
+	for (const vector<Point> &Cont : Cleaned) Raw.Add(Cont);
+	vector<int> Ids;
+	size_t Nb_points = 0;
+	for (const vector<Point> &Cont : Cleaned) Nb_points += Cont.size();
+
+	//Heron's formula and std::set on vectors
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Extract4Corners(Cleaned, Quads, Length_min, Length_max);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	CornersDuration[i][0] = double(Nb_points);
+	CornersDuration[i][1] = Fp_ms.count() / Nb_frames;
+
+	//Integer kernel on the arena
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Ids.resize(Raw.Size());
+		for (int k = 0; k < Raw.Size(); ++k) Ids[k] = k;
+		Extract4Corners(Raw, Ids, Set_quads, Length_min, Length_max);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	CornersDuration[i][2] = Fp_ms.count() / Nb_frames;
+	CornersDuration[i][3] = CornersDuration[i][1] / CornersDuration[i][2];
+
+	//Same corners (both keep the order of the contours), up to the equal areas of a side
+	int Nb_diff = abs(int(Quads.size()) - Set_quads.Size());
+	vector<Point> Quad;
+	for (int k = 0; k < MIN(int(Quads.size()), Set_quads.Size()); ++k) {
+		Set_quads.Get(k, Quad);
+		if (Quad != Quads[k]) Nb_diff++;
+	}
+	CornersDuration[i][4] = Nb_diff;
+
+	//Former chain of the session against the quad fitted on the hull
+	ContourSet Set_hulls, Set_approxs;
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Ids.resize(Raw.Size());
+		for (int k = 0; k < Raw.Size(); ++k) Ids[k] = k;
+		Hulls(Raw, Ids, Set_hulls, Length_min, Length_max);
+		Approxs(Set_hulls, Ids, Set_approxs, Length_min, Length_max);
+		Extract4Corners(Set_approxs, Ids, Set_quads, Length_min, Length_max);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	CornersDuration[i][5] = Fp_ms.count() / Nb_frames;
+
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Ids.resize(Raw.Size());
+		for (int k = 0; k < Raw.Size(); ++k) Ids[k] = k;
+		HullQuads(Raw, Ids, Set_quads, Length_min, Length_max);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	CornersDuration[i][6] = Fp_ms.count() / Nb_frames;
+	CornersDuration[i][7] = CornersDuration[i][5] / CornersDuration[i][6];
+	CornersDuration[i][8] = Set_quads.Size();
+
+	cout << "Contours points : 		" << Nb_points << " (" << Cleaned.size() << " contours)" << endl;
+	cout << "Extract 4 Corners vector : 	" << CornersDuration[i][1] << " ms" << endl;
+	cout << "Extract 4 Corners ContourSet : 	" << CornersDuration[i][2] << " ms (x" << CornersDuration[i][3] << ")" << endl;
+	cout << "Different quads : 		" << Nb_diff << " / " << Quads.size() << endl;
+	cout << "Hulls + Approxs + Extract : 	" << CornersDuration[i][5] << " ms ("
+		 << 1000 * CornersDuration[i][5] / MAX(1, Raw.Size()) << " us per contour)" << endl;
+	cout << "Hull Quads : 			" << CornersDuration[i][6] << " ms (x" << CornersDuration[i][7] << ", "
+		 << 1000 * CornersDuration[i][6] / MAX(1, Raw.Size()) << " us per contour, " << Set_quads.Size() << " quads)" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsColorTable(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Color Table Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Unity like frame
+	Mat Rgba, Bgr, Mask[3];
+	cvtColor(Src, Rgba, CV_BGR2RGBA);
+	const Color32 *Frame = reinterpret_cast<const Color32 *>(Rgba.data);
+	const uint W = Src.cols, H = Src.rows;
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	const DetectorSession Session(W, H, Params);	// Only for the background color range
+	const Scalar &Lower = Session._Lower, &Higher = Session._Higher;
+	ColorTable Table;
+	Table.AddBox(Lower, Higher);
+
+	//Conversion + inRange
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		cvtColor(Mat(H, W, CV_8UC4, const_cast<Color32 *>(Frame)), Bgr, CV_RGBA2BGR);
+		inRange(Bgr, Lower, Higher, Mask[0]);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	TableDuration[i][0] = Fp_ms.count() / Nb_frames;
+
+	//One lookup by pixel
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		BackgroundMask(Frame, W, H, Table, Mask[1]);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	TableDuration[i][1] = Fp_ms.count() / Nb_frames;
+	TableDuration[i][2] = TableDuration[i][0] / TableDuration[i][1];
+	//The table is quantised by cells of 8 levels: differences only near the bounds of the box
+	TableDuration[i][3] = countNonZero(Mask[0] != Mask[1]);
+
+	//Background learned on the top band of the image
+	Table.Clear();
+	Table.AddSamples(Src(Rect(0, 0, Src.cols, MAX(1, Src.rows / 20))));
+	Table.Dilate(Params.colorRange >> ColorTable::SHIFT);
+	BackgroundMask(Src, Table, Mask[2]);
+	TableDuration[i][4] = 100.0 * countNonZero(Mask[2]) / Mask[2].total();
+
+	cout << "Time Conversion + inRange : 	" << TableDuration[i][0] << " ms" << endl;
+	cout << "Time Color Table : 		" << TableDuration[i][1] << " ms (x" << TableDuration[i][2] << ")" << endl;
+	cout << "Different pixels : 		" << TableDuration[i][3] << endl;
+	cout << "Learned border background : 	" << TableDuration[i][4] << " %" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsFusedEdge(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Fused Edge Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Unity like frame
+	Mat Rgba, Bgr, Edges[2];
+	cvtColor(Src, Rgba, CV_BGR2RGBA);
+	const Color32 *Frame = reinterpret_cast<const Color32 *>(Rgba.data);
+	const uint W = Src.cols, H = Src.rows;
+
+	//RGBA->BGR, then gray, blur and Canny each on the full frame
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		cvtColor(Mat(H, W, CV_8UC4, const_cast<Color32 *>(Frame)), Bgr, CV_RGBA2BGR);
+		BinaryEdgeDetector(Bgr, Edges[0]);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	FusedEdgeDuration[i][0] = Fp_ms.count() / Nb_frames;
+
+	//One sweep
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		EdgeMap(Frame, W, H, Edges[1]);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	FusedEdgeDuration[i][1] = Fp_ms.count() / Nb_frames;
+	FusedEdgeDuration[i][2] = FusedEdgeDuration[i][0] / FusedEdgeDuration[i][1];
+	FusedEdgeDuration[i][3] = countNonZero(Edges[0] != Edges[1]);
+
+	cout << "Time Conversion + Edge Detector : " << FusedEdgeDuration[i][0] << " ms" << endl;
+	cout << "Time Edge Map : 		" << FusedEdgeDuration[i][1] << " ms (x" << FusedEdgeDuration[i][2] << ")" << endl;
+	cout << "Different pixels : 		" << FusedEdgeDuration[i][3] << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsRectify(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Rectify Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	DetectorSession Session(Src.cols, Src.rows, Params);
+	vector<vector<Point>> Docs;
+	if (DocsDetection(Session, Src, Docs) != NO_ERRORS || Docs.empty()) { return; }
+	//The quads are counterclockwise from the top left corner
+	const Point Quad[4] = {Docs[0][0], Docs[0][3], Docs[0][2], Docs[0][1]};
+
+	//Former extraction: transform and warp on every call, at the quad size
+	Mat Warped, Rectified[2];
+	const float W = float(sqrt(MAX(SquaredDist(Quad[0], Quad[1]), SquaredDist(Quad[2], Quad[3])))),
+				H = float(sqrt(MAX(SquaredDist(Quad[1], Quad[2]), SquaredDist(Quad[3], Quad[0]))));
+	const Point2f R1[4] = {Point2f(Quad[0]), Point2f(Quad[1]), Point2f(Quad[2]), Point2f(Quad[3])},
+				  R2[4] = {Point2f(0.0f, 0.0f), Point2f(W - 1.0f, 0.0f), Point2f(W - 1.0f, H - 1.0f), Point2f(0.0f, H - 1.0f)};
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		warpPerspective(Src, Warped, getPerspectiveTransform(R1, R2), Size(int(W), int(H)));
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	RectifyDuration[i][0] = double(Warped.total());
+	RectifyDuration[i][1] = Fp_ms.count() / Nb_frames;
+
+	//Same size, the tables are computed once then reused
+	Rectifier Full;
+	T1 = high_resolution_clock::now();
+	Full.Rectify(Src, Quad, Rectified[0]);
+	Fp_ms = high_resolution_clock::now() - T1;
+	RectifyDuration[i][2] = Fp_ms.count();
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Full.Rectify(Src, Quad, Rectified[0]);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	RectifyDuration[i][3] = Fp_ms.count() / Nb_frames;
+	RectifyDuration[i][4] = RectifyDuration[i][1] / RectifyDuration[i][3];
+	Mat Diff;
+	absdiff(Warped, Rectified[0], Diff);
+	RectifyDuration[i][5] = mean(mean(Diff))[0];
+
+	//Bounded size, the document is averaged down before the remap
+	Rectifier Bounded(512);
+	Bounded.Rectify(Src, Quad, Rectified[1]);
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Bounded.Rectify(Src, Quad, Rectified[1]);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	RectifyDuration[i][6] = Fp_ms.count() / Nb_frames;
+	RectifyDuration[i][7] = RectifyDuration[i][1] / RectifyDuration[i][6];
+
+	cout << "Document : 			" << Warped.cols << " x " << Warped.rows << endl;
+	cout << "Transform + warp : 		" << RectifyDuration[i][1] << " ms" << endl;
+	cout << "Rectifier first frame : 	" << RectifyDuration[i][2] << " ms" << endl;
+	cout << "Rectifier still quad : 		" << RectifyDuration[i][3] << " ms (x" << RectifyDuration[i][4] << ")" << endl;
+	cout << "Mean difference : 		" << RectifyDuration[i][5] << endl;
+	cout << "Rectifier 512 still quad : 	" << RectifyDuration[i][6] << " ms (x" << RectifyDuration[i][7] << ", "
+		 << Rectified[1].cols << " x " << Rectified[1].rows << ")" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsQuadFeatures(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "===== Test Quad Features Image " << NAMES[i] << " =====" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	Params.rectifiedSide = 0;	// Same document as before the rectifier bound
+	DetectorSession Session(Src.cols, Src.rows, Params);
+	vector<Point> Quad;
+	Mat Doc;
+	if (DocExtraction(Session, Src, Quad, Doc) != NO_ERRORS) { return; }
+
+	//Rectified document then histograms (a new quad each frame: no cached tables)
+	//The quad is counterclockwise from the top left corner, the rectifier wants it clockwise
+	const Point Corners[4] = {Quad[0], Quad[3], Quad[2], Quad[1]};
+	DocFeatures Warped, In_quad, In_quad_2;
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		Session._Rectifier.Clear();
+		Session._Rectifier.Rectify(Src, Corners, Doc);
+		Warped.ExtractFeatures(Doc);
+	}
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	QuadFeaturesDuration[i][0] = Fp_ms.count() / Nb_frames;
+
+	//Histograms straight from the pixels of the quad
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		In_quad.ExtractFeaturesInQuad(Src, Quad);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	QuadFeaturesDuration[i][1] = Fp_ms.count() / Nb_frames;
+	QuadFeaturesDuration[i][2] = QuadFeaturesDuration[i][0] / QuadFeaturesDuration[i][1];
+
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) {
+		In_quad_2.ExtractFeaturesInQuad(Src, Quad, 2);
+	}
+	Fp_ms = high_resolution_clock::now() - T1;
+	QuadFeaturesDuration[i][4] = Fp_ms.count() / Nb_frames;
+	QuadFeaturesDuration[i][5] = QuadFeaturesDuration[i][0] / QuadFeaturesDuration[i][4];
+
+	for (size_t k = 0; k < Warped._Histograms.size(); ++k) {
+		QuadFeaturesDuration[i][3] += abs(Warped._Histograms[k] - In_quad._Histograms[k]);
+		QuadFeaturesDuration[i][6] += abs(Warped._Histograms[k] - In_quad_2._Histograms[k]);
+	}
+
+	cout << "Extraction + Features : 	" << QuadFeaturesDuration[i][0] << " ms" << endl;
+	cout << "Features in Quad : 		" << QuadFeaturesDuration[i][1] << " ms (x" << QuadFeaturesDuration[i][2]
+		 << ", L1 " << QuadFeaturesDuration[i][3] << ")" << endl;
+	cout << "Features in Quad step 2 : 	" << QuadFeaturesDuration[i][4] << " ms (x" << QuadFeaturesDuration[i][5]
+		 << ", L1 " << QuadFeaturesDuration[i][6] << ")" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsFeatures(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "====== Test Features Image " << NAMES[i] << " ======" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+
+	//Former path: HSV image, splits, calcHist, then gray, Sobel and cartToPolar
+	DocFeatures Ref, Fused, Fused_4;
+	auto T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) Ref.ExtractFeaturesOpenCV(Src);
+	duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+	FeaturesDuration[i][0] = Fp_ms.count() / Nb_frames;
+
+	//One read of each pixel, no intermediate image
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) Fused.ExtractFeatures(Src);
+	Fp_ms = high_resolution_clock::now() - T1;
+	FeaturesDuration[i][1] = Fp_ms.count() / Nb_frames;
+	FeaturesDuration[i][2] = FeaturesDuration[i][0] / FeaturesDuration[i][1];
+
+	T1 = high_resolution_clock::now();
+	for (int f = 0; f < Nb_frames; ++f) Fused_4.ExtractFeatures(Src, 4);
+	Fp_ms = high_resolution_clock::now() - T1;
+	FeaturesDuration[i][3] = Fp_ms.count() / Nb_frames;
+	FeaturesDuration[i][4] = FeaturesDuration[i][0] / FeaturesDuration[i][3];
+
+	for (size_t k = 0; k < Ref._Histograms.size(); ++k) {
+		FeaturesDuration[i][5] += abs(Ref._Histograms[k] - Fused._Histograms[k]);
+	}
+	for (size_t k = 0; k < Ref._HOG.size(); ++k) {
+		FeaturesDuration[i][6] += abs(Ref._HOG[k] - Fused._HOG[k]);
+	}
+
+	cout << "OpenCV features : 		" << FeaturesDuration[i][0] << " ms" << endl;
+	cout << "Fused features : 		" << FeaturesDuration[i][1] << " ms (x" << FeaturesDuration[i][2] << ")" << endl;
+	cout << "Fused features 4 threads : 	" << FeaturesDuration[i][3] << " ms (x" << FeaturesDuration[i][4] << ")" << endl;
+	cout << "L1 histograms : " << FeaturesDuration[i][5] << "\tL1 HOG : " << FeaturesDuration[i][6] << endl;
+	cout << "======================================" << endl << endl;
+}
+
+void TestsBands(const int i = 0)
+{
+	cout << "======================================" << endl;
+	cout << "======= Test Bands Image " << NAMES[i] << " =======" << endl;
+
+	const int Nb_frames = 30;
+	const Mat Src = imread(PATH + NAMES[i] + EXT, CV_LOAD_IMAGE_COLOR);
+	if (Src.cols == 0 || Src.rows == 0) { return; }
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	const DetectorSession Session(Src.cols, Src.rows, Params);	// Only for the background color range
+	const Scalar &Lower = Session._Lower, &Higher = Session._Higher;
+
+	//Serial references
+	Mat Mask_ref, Edges_ref, Bordered;
+	inRange(Src, Lower, Higher, Mask_ref);
+	BinaryEdgeDetector(Src, Edges_ref);
+	vector<vector<Point>> Contours_ref;
+	copyMakeBorder(Mask_ref, Bordered, 1, 1, 1, 1, BORDER_CONSTANT, Scalar(0));
+	findContours(Bordered.clone(), Contours_ref, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, Point(-1, -1));
+
+	ofstream File;
+	File.open(PATH + "Bands" + NAMES[i] + ".csv");
+	File << "Threads;Mask (ms);Edges (ms);Contours (ms);Different pixels;Different contours\n";
+	Mat Mask, Edges, Binary;
+	ContourTracer Tracer;
+	ContourSet Contours;
+	for (const int Nb_threads : {1, 2, 4, 8}) {
+		auto T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) BackgroundMask(Src, Lower, Higher, Mask, 1, Nb_threads);
+		const duration<double, std::milli> Mask_ms = high_resolution_clock::now() - T1;
+
+		T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) EdgeMap(Src, Edges, 50, 205, Nb_threads);
+		const duration<double, std::milli> Edges_ms = high_resolution_clock::now() - T1;
+
+		duration<double, std::milli> Contours_ms(0);
+		for (int f = 0; f < Nb_frames; ++f) {
+			Bordered.copyTo(Binary);	// The tracer modifies its image
+			T1 = high_resolution_clock::now();
+			Tracer.Find(Binary, Contours, CV_CHAIN_APPROX_SIMPLE, Nb_threads, Point(-1, -1));
+			Contours_ms += high_resolution_clock::now() - T1;
+		}
+
+		//Same pixels and same contours (same points in the same order) as the serial functions
+		const int Diff_pixels = countNonZero(Mask != Mask_ref) + countNonZero(Edges != Edges_ref);
+		int Diff_contours = abs(Contours.Size() - int(Contours_ref.size()));
+		vector<Point> Contour;
+		for (int c = 0; c < MIN(Contours.Size(), int(Contours_ref.size())); ++c) {
+			Contours.Get(c, Contour);
+			if (Contour != Contours_ref[c]) Diff_contours++;
+		}
+
+		cout << Nb_threads << " threads : \t" << Mask_ms.count() / Nb_frames << " ms (mask)\t" << Edges_ms.count() / Nb_frames
+			 << " ms (edges)\t" << Contours_ms.count() / Nb_frames << " ms (contours)" << endl;
+		cout << "Different pixels : " << Diff_pixels << "\tDifferent contours : " << Diff_contours << endl;
+		File << Nb_threads << ";" << Mask_ms.count() / Nb_frames << ";" << Edges_ms.count() / Nb_frames << ";"
+			 << Contours_ms.count() / Nb_frames << ";" << Diff_pixels << ";" << Diff_contours << "\n";
+	}
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
+//Former distance on vectors of double (coefs by value, one allocation per call, scalar loops)
+double VectorsDistance(const vector<double> &hog_a, const vector<double> &hists_a, const vector<double> &hog_b,
+					   const vector<double> &hists_b, int bins, vector<double> coefs)
+{
+	vector<double> Dists_Val(7, 0.0);
+	for (size_t i = 0; i < hog_a.size(); ++i) Dists_Val[0] += (hog_a[i] - hog_b[i]) * (hog_a[i] - hog_b[i]);
+	for (int i = 0; i < 6; ++i) {
+		for (int j = i * bins; j < (i + 1) * bins; ++j) Dists_Val[i + 1] += (hists_a[j] - hists_b[j]) * (hists_a[j] - hists_b[j]);
+	}
+	double Res = 0.0, Coefs = 0.0;
+	for (int i = 0; i < 7; ++i) {
+		Res += sqrt(Dists_Val[i]) * coefs[i];
+		Coefs += coefs[i];
+	}
+	return ((1 - ((Res / Coefs) / sqrt(2))) * 100);
+}
+
+//All the pairs of the images, Nb_rounds times, with the features of one layout
+template <typename Features>
+void DistanceLayout(const vector<Mat> &srcs, const string &name, const vector<double> &reference, vector<double> &similarities,
+					ofstream &file)
+{
+	const int Nb_rounds = 10000;
+	vector<Features> F(srcs.size());
+	for (size_t k = 0; k < srcs.size(); ++k) F[k].ExtractFeatures(srcs[k]);
+
+	double Sum = 0.0;
+	const auto T1 = high_resolution_clock::now();
+	for (int r = 0; r < Nb_rounds; ++r) {
+		for (size_t a = 0; a < F.size(); ++a) {
+			for (size_t b = 0; b < F.size(); ++b) Sum += F[a].Distance(F[b]);
+		}
+	}
+	const duration<double, std::nano> Fp_ns = high_resolution_clock::now() - T1;
+	const double Ns = Fp_ns.count() / (double(Nb_rounds) * F.size() * F.size());
+
+	similarities.clear();
+	double Max_diff = 0.0;
+	for (size_t a = 0; a < F.size(); ++a) {
+		for (size_t b = 0; b < F.size(); ++b) similarities.push_back(F[a].Distance(F[b]));
+	}
+	for (size_t k = 0; k < reference.size() && k < similarities.size(); ++k) {
+		Max_diff = MAX(Max_diff, abs(reference[k] - similarities[k]));
+	}
+	cout << name << " : 	" << sizeof(Features) << " bytes	" << Ns << " ns	(max difference " << Max_diff << ", " << Sum << ")" << endl;
+	file << name << ";" << sizeof(Features) << ";" << Ns << ";" << Max_diff << "\n";
+}
+
+void TestsDistance()
+{
+	cout << "======================================" << endl;
+	cout << "=========== Test Distance ============" << endl;
+
+	vector<Mat> Srcs;
+	for (const string &Name : NAMES) {
+		const Mat Src = imread(PATH + Name + EXT, CV_LOAD_IMAGE_COLOR);
+		if (Src.cols != 0 && Src.rows != 0) Srcs.push_back(Src);
+	}
+	if (Srcs.empty()) { return; }
+
+	ofstream File;
+	File.open(PATH + "DistanceDuration.csv");
+	File << "Layout;Record (bytes);Distance (ns);Max similarity difference\n";
+
+	//Former records: two vectors of double
+	const int Nb_rounds = 10000;
+	vector<DocFeatures> F(Srcs.size());
+	vector<vector<double>> HOGs(Srcs.size()), Hists(Srcs.size());
+	for (size_t k = 0; k < Srcs.size(); ++k) {
+		F[k].ExtractFeatures(Srcs[k]);
+		for (int i = 0; i < DocFeatures::_HOGBins; ++i) HOGs[k].push_back(F[k].HOGValue(i));
+		for (int i = 0; i < DocFeatures::_HistoChans * DocFeatures::_HistoBins; ++i) Hists[k].push_back(F[k].HistoValue(i));
+	}
+	const vector<double> Coefs(DEFAULT_FEATURES_COEFS.begin(), DEFAULT_FEATURES_COEFS.end());
+	double Sum = 0.0;
+	const auto T1 = high_resolution_clock::now();
+	for (int r = 0; r < Nb_rounds; ++r) {
+		for (size_t a = 0; a < Srcs.size(); ++a) {
+			for (size_t b = 0; b < Srcs.size(); ++b) Sum += VectorsDistance(HOGs[a], Hists[a], HOGs[b], Hists[b], 10, Coefs);
+		}
+	}
+	const duration<double, std::nano> Fp_ns = high_resolution_clock::now() - T1;
+	const double Ns = Fp_ns.count() / (double(Nb_rounds) * Srcs.size() * Srcs.size());
+	const size_t Bytes = 2 * sizeof(vector<double>) + (HOGs[0].size() + Hists[0].size()) * sizeof(double);
+	cout << "Vectors 10 : \t" << Bytes << " bytes\t" << Ns << " ns\t(" << Sum << ")" << endl;
+	File << "Vectors 10;" << Bytes << ";" << Ns << ";0\n";
+
+	vector<double> Reference, Server_reference, Similarities;
+	for (size_t a = 0; a < Srcs.size(); ++a) {
+		for (size_t b = 0; b < Srcs.size(); ++b) Reference.push_back(VectorsDistance(HOGs[a], Hists[a], HOGs[b], Hists[b], 10, Coefs));
+	}
+	DistanceLayout<DocFeatures>(Srcs, "Float 10", Reference, Similarities, File);
+	DistanceLayout<DocFeatures16>(Srcs, "Ushort 10", Reference, Similarities, File);
+	DistanceLayout<DocFeatures8>(Srcs, "Uchar 10", Reference, Similarities, File);
+	DistanceLayout<ServerFeatures>(Srcs, "Float 25", vector<double>(), Server_reference, File);
+	DistanceLayout<ServerFeatures16>(Srcs, "Ushort 25", Server_reference, Similarities, File);
+	DistanceLayout<ServerFeatures8>(Srcs, "Uchar 25", Server_reference, Similarities, File);
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
+void TestsMatch()
+{
+	cout << "======================================" << endl;
+	cout << "============= Test Match =============" << endl;
+
+	vector<DocFeatures> Images;
+	for (const string &Name : NAMES) {
+		const Mat Src = imread(PATH + Name + EXT, CV_LOAD_IMAGE_COLOR);
+		if (Src.cols == 0 || Src.rows == 0) continue;
+		Images.emplace_back();
+		Images.back().ExtractFeatures(Src);
+	}
+	if (Images.empty()) { return; }
+
+	//Database: noisy copies of the images, the first ones are the images themselves
+	const int Nb_queries = 100, K = 5;
+	const int Size = 200000;
+	RNG Rng(42);
+	vector<DocFeatures> Db(Size);
+	Mat Matrix(Size, DocFeatures::_RowSize, CV_32FC1);
+	for (int r = 0; r < Size; ++r) {
+		Db[r] = Images[r % Images.size()];
+		if (r >= int(Images.size())) {
+			for (float &Val : Db[r]._Histograms) Val = MAX(0.0f, Val + float(Rng.gaussian(0.01)));
+			for (float &Val : Db[r]._HOG) Val = MAX(0.0f, Val + float(Rng.gaussian(0.01)));
+		}
+		Db[r].ToRow(Matrix.ptr<float>(r));
+	}
+
+	//Former scan: one Distance by record, then the k best
+	vector<pair<double, int>> Scan(Size);
+	vector<int> Ids;
+	vector<float> Dists;
+	int Diff_ids = 0;
+	duration<double, std::milli> Scan_ms(0), Match_ms(0);
+	for (int q = 0; q < Nb_queries; ++q) {
+		const DocFeatures &Query = Images[q % Images.size()];
+		auto T1 = high_resolution_clock::now();
+		for (int r = 0; r < Size; ++r) Scan[r] = make_pair(-Query.Distance(Db[r]), r);
+		partial_sort(Scan.begin(), Scan.begin() + K, Scan.end());
+		Scan_ms += high_resolution_clock::now() - T1;
+
+		T1 = high_resolution_clock::now();
+		MatchTopK(Query, Matrix, K, Ids, Dists);
+		Match_ms += high_resolution_clock::now() - T1;
+		for (int k = 0; k < K; ++k) Diff_ids += Ids[k] != Scan[k].second;
+	}
+
+	const double Scan_rate = Size / (Scan_ms.count() / Nb_queries) / 1000, Match_rate = Size / (Match_ms.count() / Nb_queries) / 1000;
+	cout << "Distance scan : \t" << Scan_ms.count() / Nb_queries << " ms\t(" << Scan_rate << " M/s)" << endl;
+	cout << "MatchTopK : \t\t" << Match_ms.count() / Nb_queries << " ms\t(" << Match_rate << " M/s, x" << Match_rate / Scan_rate
+		 << ")" << endl;
+	cout << "Different ids : " << Diff_ids << endl;
+	ofstream File;
+	File.open(PATH + "MatchDuration.csv");
+	File << "Records;Distance scan (ms);MatchTopK (ms);Speedup;Different ids\n";
+	File << Size << ";" << Scan_ms.count() / Nb_queries << ";" << Match_ms.count() / Nb_queries << ";"
+		 << Match_rate / Scan_rate << ";" << Diff_ids << "\n";
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
+//Synthetic document: histograms and HOG drawn from a Dirichlet distribution (normalised gamma draws)
+DocFeatures SyntheticFeatures(mt19937 &rng)
+{
+	gamma_distribution<float> Gamma(0.5f, 1.0f);
+	DocFeatures F;
+	for (int c = 0; c < DocFeatures::_HistoChans; ++c) {
+		float Sum = 0.0f;
+		for (int j = 0; j < DocFeatures::_HistoBins; ++j) Sum += F._Histograms[c * DocFeatures::_HistoBins + j] = Gamma(rng);
+		for (int j = 0; j < DocFeatures::_HistoBins; ++j) F._Histograms[c * DocFeatures::_HistoBins + j] /= Sum;
+	}
+	float Sum = 0.0f;
+	for (float &Val : F._HOG) Sum += Val = Gamma(rng);
+	for (float &Val : F._HOG) Val /= Sum;
+	return F;
+}
+
+//Recall at 1 of the index against MatchTopK on the documents alive, the queries are alive documents seen again with noise
+double IndexRecall(const DocIndex &index, const vector<DocFeatures> &docs, const vector<bool> &alive, const int nb_queries,
+				   const float noise, mt19937 &rng, double &index_ms, double &brute_ms)
+{
+	vector<int> Row_ids;
+	for (int d = 0; d < int(docs.size()); ++d) {
+		if (alive[d]) Row_ids.push_back(d);
+	}
+	Mat Matrix(int(Row_ids.size()), DocFeatures::_RowSize, CV_32FC1);
+	for (int r = 0; r < Matrix.rows; ++r) docs[Row_ids[r]].ToRow(Matrix.ptr<float>(r));
+
+	normal_distribution<float> Gaussian(0.0f, noise);
+	vector<int> Ids;
+	vector<float> Dists;
+	duration<double, std::milli> Index_ms(0), Brute_ms(0);
+	int Found = 0;
+	for (int q = 0; q < nb_queries; ++q) {
+		DocFeatures Query = docs[Row_ids[rng() % Row_ids.size()]];
+		for (float &Val : Query._Histograms) Val = MAX(0.0f, Val + Gaussian(rng));
+		for (float &Val : Query._HOG) Val = MAX(0.0f, Val + Gaussian(rng));
+		auto T1 = high_resolution_clock::now();
+		MatchTopK(Query, Matrix, 1, Ids, Dists);
+		Brute_ms += high_resolution_clock::now() - T1;
+		const int Truth = Row_ids[Ids[0]];
+		T1 = high_resolution_clock::now();
+		index.Search(Query, 1, Ids, Dists);
+		Index_ms += high_resolution_clock::now() - T1;
+		Found += !Ids.empty() && Ids[0] == Truth;
+	}
+	index_ms = Index_ms.count() / nb_queries;
+	brute_ms = Brute_ms.count() / nb_queries;
+	return double(Found) / nb_queries;
+}
+
+void TestsIndex()
+{
+	cout << "======================================" << endl;
+	cout << "============= Test Index =============" << endl;
+
+	//Queries: documents of the collection seen again with noise
+	const int Nb_queries = 1000;
+	const float Noise = 0.05f;
+	mt19937 Rng(42);
+	normal_distribution<float> Gaussian(0.0f, Noise);
+
+	ofstream File;
+	File.open(PATH + "IndexDuration.csv");
+	File << "Documents;Build (s);ef;Recall at 1;Index (ms);Brute force (ms);Speedup\n";
+	ofstream Updates;
+	Updates.open(PATH + "IndexUpdates.csv");
+	Updates << "Documents;Stage;Duration (s);Alive;Waypoints;Recall at 1;Index (ms);Brute force (ms)\n";
+	for (const int Size : {10000, 100000, 1000000}) {
+		vector<DocFeatures> Docs(Size);
+		Mat Matrix(Size, DocFeatures::_RowSize, CV_32FC1);
+		for (int r = 0; r < Size; ++r) {
+			Docs[r] = SyntheticFeatures(Rng);
+			Docs[r].ToRow(Matrix.ptr<float>(r));
+		}
+		vector<DocFeatures> Queries(Nb_queries);
+		for (DocFeatures &Query : Queries) {
+			Query = Docs[Rng() % Size];
+			for (float &Val : Query._Histograms) Val = MAX(0.0f, Val + Gaussian(Rng));
+			for (float &Val : Query._HOG) Val = MAX(0.0f, Val + Gaussian(Rng));
+		}
+
+		DocIndex Index;
+		auto T1 = high_resolution_clock::now();
+		for (int r = 0; r < Size; ++r) Index.Insert(r, Docs[r]);
+		const duration<double> Build_s = high_resolution_clock::now() - T1;
+
+		//Exact nearest documents
+		vector<int> Truth(Nb_queries), Ids;
+		vector<float> Dists;
+		T1 = high_resolution_clock::now();
+		for (int q = 0; q < Nb_queries; ++q) {
+			MatchTopK(Queries[q], Matrix, 1, Ids, Dists);
+			Truth[q] = Ids[0];
+		}
+		const duration<double, std::milli> Brute_ms = high_resolution_clock::now() - T1;
+		cout << Size << " documents : \tbuild " << Build_s.count() << " s\tbrute force " << Brute_ms.count() / Nb_queries << " ms" << endl;
+
+		for (const int Ef : {8, 16, 32, 64, 128}) {
+			Index.SetSearch(Ef);
+			int Found = 0;
+			T1 = high_resolution_clock::now();
+			for (int q = 0; q < Nb_queries; ++q) {
+				Index.Search(Queries[q], 1, Ids, Dists);
+				Found += !Ids.empty() && Ids[0] == Truth[q];
+			}
+			const duration<double, std::milli> Index_ms = high_resolution_clock::now() - T1;
+			const double Recall = double(Found) / Nb_queries;
+			cout << "ef " << Ef << " : \trecall@1 " << Recall << "\t" << Index_ms.count() / Nb_queries << " ms\t(x"
+				 << Brute_ms.count() / Index_ms.count() << ")" << endl;
+			File << Size << ";" << Build_s.count() << ";" << Ef << ";" << Recall << ";" << Index_ms.count() / Nb_queries << ";"
+				 << Brute_ms.count() / Nb_queries << ";" << Brute_ms.count() / Index_ms.count() << "\n";
+		}
+
+		//Removes and updates: 30% of the documents removed, then 30% updated by Insert (the former nodes stay as waypoints),
+		//then 10% more removed: the waypoints outnumber the documents halfway and the graph is rebuilt
+		Index.SetSearch(64);
+		vector<bool> Alive(Size, true);
+		vector<int> Order(Size);
+		for (int r = 0; r < Size; ++r) Order[r] = r;
+		shuffle(Order.begin(), Order.end(), Rng);
+		const int Nb_removed = 3 * Size / 10, Nb_updated = 3 * Size / 10, Nb_more = Size / 10;
+		const char *Stages[] = {"removed 30%", "updated 30%", "removed 10%"};
+		const int Ends[] = {Nb_removed, Nb_removed + Nb_updated, Nb_removed + Nb_updated + Nb_more};
+		for (int s = 0, Begin = 0; s < 3; Begin = Ends[s++]) {
+			T1 = high_resolution_clock::now();
+			for (int i = Begin; i < Ends[s]; ++i) {
+				const int Id = Order[i];
+				if (s == 1) {
+					Docs[Id] = SyntheticFeatures(Rng);
+					Index.Insert(Id, Docs[Id]);
+				}
+				else {
+					Index.Remove(Id);
+					Alive[Id] = false;
+				}
+			}
+			const duration<double> Update_s = high_resolution_clock::now() - T1;
+			double Index_ms, Brute_ms;
+			const double Recall = IndexRecall(Index, Docs, Alive, Nb_queries, Noise, Rng, Index_ms, Brute_ms);
+			cout << Stages[s] << " : 	" << Update_s.count() << " s	" << Index.Size() << " documents, " << Index.Waypoints()
+				 << " waypoints	recall@1 " << Recall << "\t" << Index_ms << " ms\t(x" << Brute_ms / Index_ms << ")" << endl;
+			Updates << Size << ";" << Stages[s] << ";" << Update_s.count() << ";" << Index.Size() << ";" << Index.Waypoints() << ";"
+					<< Recall << ";" << Index_ms << ";" << Brute_ms << "\n";
+		}
+	}
+	File.close();
+	Updates.close();
+	cout << "======================================" << endl << endl;
+}
+
+void TestsPQ()
+{
+	cout << "======================================" << endl;
+	cout << "============== Test PQ ===============" << endl;
+
+	const int Size = 1000000, Nb_train = 20000, Nb_queries = 200;
+	const float Noise = 0.05f;
+	mt19937 Rng(42);
+	normal_distribution<float> Gaussian(0.0f, Noise);
+	Mat Matrix(Size, DocFeatures::_RowSize, CV_32FC1);
+	for (int r = 0; r < Size; ++r) SyntheticFeatures(Rng).ToRow(Matrix.ptr<float>(r));
+	vector<DocFeatures> Queries(Nb_queries);
+	for (DocFeatures &Query : Queries) {
+		const float *Row = Matrix.ptr<float>(Rng() % Size);
+		for (int i = 0; i < DocFeatures::_HOGBins; ++i) Query._HOG[i] = MAX(0.0f, Row[i] + Gaussian(Rng));
+		for (int i = 0; i < DocFeatures::_HistoChans * DocFeatures::_HistoBins; ++i) {
+			Query._Histograms[i] = MAX(0.0f, Row[DocFeatures::_HOGBins + i] + Gaussian(Rng));
+		}
+	}
+
+	//Exact nearest documents
+	vector<int> Truth(Nb_queries), Ids;
+	vector<float> Dists;
+	auto T1 = high_resolution_clock::now();
+	for (int q = 0; q < Nb_queries; ++q) {
+		MatchTopK(Queries[q], Matrix, 1, Ids, Dists);
+		Truth[q] = Ids[0];
+	}
+	const duration<double, std::milli> Brute_ms = high_resolution_clock::now() - T1;
+	cout << "Brute force : \t" << Brute_ms.count() / Nb_queries << " ms\t(rows " << DocFeatures::_RowSize * sizeof(float)
+		 << " bytes, 25 bins codes " << ServerPQ().CodeSize() << " bytes)" << endl;
+
+	//Full rows read only for the candidates
+	const auto Load = [&Matrix](const int i, float *row) {
+		copy_n(Matrix.ptr<float>(i), int(DocFeatures::_RowSize), row);
+	};
+	ofstream File;
+	File.open(PATH + "PQDuration.csv");
+	File << "Documents;Sub-vector;Code (bytes);Re-ranked;Recall at 1;PQ (ms);Brute force (ms);Speedup\n";
+	//Default sub-vectors of 4 values, and the former ones of 5
+	for (const int Sub_dims : {DocPQ::_Default_sub_dims, 5}) {
+		DocPQ PQ(Sub_dims);
+		Mat Codes;
+		if (PQ.Encode(Matrix, Codes)) cout << "Encoded without codebooks" << endl;
+		T1 = high_resolution_clock::now();
+		PQ.Train(Matrix.rowRange(0, Nb_train));
+		const duration<double> Train_s = high_resolution_clock::now() - T1;
+		PQ.Encode(Matrix, Codes);
+		cout << "Sub-vectors of " << Sub_dims << " : \t" << PQ.CodeSize() << " bytes\ttraining " << Train_s.count() << " s" << endl;
+
+		for (const int Rerank : {0, 16, 64, 256}) {
+			int Found = 0;
+			T1 = high_resolution_clock::now();
+			for (int q = 0; q < Nb_queries; ++q) {
+				PQ.Match(Queries[q], Codes, 1, Rerank, Load, Ids, Dists);
+				Found += !Ids.empty() && Ids[0] == Truth[q];
+			}
+			const duration<double, std::milli> PQ_ms = high_resolution_clock::now() - T1;
+			const double Recall = double(Found) / Nb_queries;
+			cout << "Re-ranked " << Rerank << " : \trecall@1 " << Recall << "\t" << PQ_ms.count() / Nb_queries << " ms\t(x"
+				 << Brute_ms.count() / PQ_ms.count() << ")" << endl;
+			File << Size << ";" << Sub_dims << ";" << PQ.CodeSize() << ";" << Rerank << ";" << Recall << ";"
+				 << PQ_ms.count() / Nb_queries << ";" << Brute_ms.count() / Nb_queries << ";" << Brute_ms.count() / PQ_ms.count()
+				 << "\n";
+		}
+	}
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
+//Synthetic document: blocks of colour and lines of "text" on a sheet of paper
+Mat SyntheticDocument(mt19937 &rng)
+{
+	uniform_int_distribution<int> Colour(0, 255), X(0, 209), Y(0, 296), Count(2, 6);
+	Mat Doc(297, 210, CV_8UC3, Scalar(235, 240, 245));
+	for (int b = Count(rng); b > 0; --b) {
+		const Point P(X(rng), Y(rng));
+		rectangle(Doc, P, P + Point(20 + X(rng) / 3, 20 + Y(rng) / 4), Scalar(Colour(rng), Colour(rng), Colour(rng)), CV_FILLED);
+	}
+	for (int l = Count(rng) * 3; l > 0; --l) {
+		const Point P(X(rng) / 2, Y(rng));
+		line(Doc, P, P + Point(30 + X(rng) / 2, 0), Scalar(40, 40, 40), 2);
+	}
+	return Doc;
+}
+
+//Document seen again: rectified a little differently, other lighting, sensor noise
+Mat SeenAgain(const Mat &doc, mt19937 &rng)
+{
+	uniform_real_distribution<double> Shift(-4.0, 4.0), Gain(0.85, 1.15);
+	const Point2f Src[3] = {Point2f(0, 0), Point2f(float(doc.cols), 0), Point2f(0, float(doc.rows))};
+	Point2f Dst[3];
+	for (int i = 0; i < 3; ++i) Dst[i] = Src[i] + Point2f(float(Shift(rng)), float(Shift(rng)));
+	Mat Again, Noise(doc.size(), CV_16SC3);
+	warpAffine(doc, Again, getAffineTransform(Src, Dst), doc.size(), INTER_LINEAR, BORDER_REPLICATE);
+	randn(Noise, 0, 6);
+	Again.convertTo(Again, CV_16SC3, Gain(rng), 10 * Shift(rng));
+	Again += Noise;
+	Again.convertTo(Again, CV_8UC3);
+	return Again;
+}
+
+//Multi-index hash search against a scan of the Hamming distances to every document, same documents expected
+void HashSearchComparison(const vector<uint64> &hashes, const vector<uint64> &queries)
+{
+	HashIndex Index;
+	for (int r = 0; r < int(hashes.size()); ++r) Index.Insert(r, hashes[r]);
+
+	ofstream File;
+	File.open(PATH + "HashSearchDuration.csv");
+	File << "Documents;Radius;Index (us);Scan (us);Speedup;Found;Different\n";
+	vector<pair<int, int>> Found, Scan;
+	for (const int Radius : {0, 3, 7, 12}) {
+		duration<double, std::micro> Index_us(0), Scan_us(0);
+		int Nb_found = 0, Nb_diff = 0;
+		for (const uint64 Query : queries) {
+			auto T1 = high_resolution_clock::now();
+			Index.Search(Query, Radius, Found);
+			Index_us += high_resolution_clock::now() - T1;
+
+			T1 = high_resolution_clock::now();
+			Scan.clear();
+			for (int r = 0; r < int(hashes.size()); ++r) {
+				const int Dist = HammingDistance(Query, hashes[r]);
+				if (Dist <= Radius) Scan.emplace_back(Dist, r);
+			}
+			sort(Scan.begin(), Scan.end());
+			Scan_us += high_resolution_clock::now() - T1;
+			Nb_found += int(Found.size());
+			Nb_diff += Found != Scan;
+		}
+		const double Nb_queries = double(queries.size());
+		cout << "Radius " << Radius << " : \tindex " << Index_us.count() / Nb_queries << " us\tscan " << Scan_us.count() / Nb_queries
+			 << " us\t(x" << Scan_us.count() / Index_us.count() << ")\tfound " << Nb_found << "\tdifferent " << Nb_diff << endl;
+		File << hashes.size() << ";" << Radius << ";" << Index_us.count() / Nb_queries << ";" << Scan_us.count() / Nb_queries << ";"
+			 << Scan_us.count() / Index_us.count() << ";" << Nb_found << ";" << Nb_diff << "\n";
+	}
+	File.close();
+}
+
+void TestsCascade()
+{
+	cout << "======================================" << endl;
+	cout << "============ Test Cascade ============" << endl;
+
+	//Known documents, queries: half of them seen again, half of them new
+	const int Size = 20000, Nb_queries = 1000;
+	mt19937 Rng(42);
+	DocCascade Cascade;
+	DocIndex Index;
+	vector<Mat> Docs(Size);
+	vector<uint64> Doc_hashes(Size);
+	for (int r = 0; r < Size; ++r) {
+		Docs[r] = SyntheticDocument(Rng);
+		DocFeatures F;
+		DocCascade::Extract(Docs[r], Doc_hashes[r], F);
+		Cascade.Insert(r, Doc_hashes[r], F);
+		Index.Insert(r, F);
+	}
+	vector<uint64> Hashes(Nb_queries);
+	vector<DocFeatures> Queries(Nb_queries);
+	vector<int> Truth(Nb_queries, -1);
+	for (int q = 0; q < Nb_queries; ++q) {
+		if (q % 2 == 0) Truth[q] = Rng() % Size;
+		DocCascade::Extract(Truth[q] < 0 ? SyntheticDocument(Rng) : SeenAgain(Docs[Truth[q]], Rng), Hashes[q], Queries[q]);
+	}
+
+	//Former matching: every query goes to the features index
+	const float Max_dist = float(0.2 * sqrt(2.0));
+	vector<int> Ids;
+	vector<float> Dists;
+	int Index_right = 0;
+	auto T1 = high_resolution_clock::now();
+	for (int q = 0; q < Nb_queries; ++q) {
+		Index.Search(Queries[q], 1, Ids, Dists);
+		Index_right += (!Ids.empty() && Dists[0] <= Max_dist ? Ids[0] : -1) == Truth[q];
+	}
+	const duration<double, std::milli> Index_ms = high_resolution_clock::now() - T1;
+
+	int Stages[3] = {0, 0, 0}, Cascade_right = 0, Id;
+	//Hash stage hits on the documents seen again, and verified on another document than the truth (false verifications)
+	int Hash_hits = 0, Hash_false = 0;
+	CASCADE_STAGE Stage;
+	double Similarity;
+	T1 = high_resolution_clock::now();
+	for (int q = 0; q < Nb_queries; ++q) {
+		Stage = Cascade.Match(Hashes[q], Queries[q], Id, Similarity);
+		Stages[Stage]++;
+		Cascade_right += Id == Truth[q];
+		if (Stage != CASCADE_HASH) continue;
+		Hash_hits += Truth[q] >= 0 && Id == Truth[q];
+		Hash_false += Id != Truth[q];
+	}
+	const duration<double, std::milli> Cascade_ms = high_resolution_clock::now() - T1;
+	const int Nb_seen = (Nb_queries + 1) / 2, Fall_through = Nb_queries - Stages[CASCADE_HASH];
+
+	cout << "Index : \t" << Index_ms.count() / Nb_queries << " ms\tright " << Index_right << " / " << Nb_queries << endl;
+	cout << "Cascade : \t" << Cascade_ms.count() / Nb_queries << " ms\tright " << Cascade_right << " / " << Nb_queries << "\t(x"
+		 << Index_ms.count() / Cascade_ms.count() << ")" << endl;
+	cout << "Stages : \thash " << Stages[CASCADE_HASH] << "\tindex " << Stages[CASCADE_INDEX] << "\tnew " << Stages[CASCADE_NEW]
+		 << endl;
+	cout << "Hash stage : \thits " << Hash_hits << " / " << Nb_seen << " seen again\tfalse verifications " << Hash_false
+		 << "\tfall through " << Fall_through << " / " << Nb_queries << endl;
+	ofstream File;
+	File.open(PATH + "CascadeDuration.csv");
+	File << "Documents;Index (ms);Index right;Cascade (ms);Cascade right;Speedup;Hash stage;Index stage;New;Hash hits;"
+			"False verifications;Fall through\n";
+	File << Size << ";" << Index_ms.count() / Nb_queries << ";" << Index_right << ";" << Cascade_ms.count() / Nb_queries << ";"
+		 << Cascade_right << ";" << Index_ms.count() / Cascade_ms.count() << ";" << Stages[CASCADE_HASH] << ";"
+		 << Stages[CASCADE_INDEX] << ";" << Stages[CASCADE_NEW] << ";" << Hash_hits << ";" << Hash_false << ";" << Fall_through
+		 << "\n";
+	File.close();
+
+	//Hash stage alone: the documents within each radius of the queries
+	HashSearchComparison(Doc_hashes, Hashes);
+	cout << "======================================" << endl << endl;
+}
+
+//Quad with the expected corners (tolerance tol), in the order of its sides one way or the other
+bool SameQuad(const Vec8i &quad, const Point2f expected[4], const float tol = 2.0f)
+{
+	int First = -1;
+	for (int k = 0; k < 4 && First < 0; ++k) {
+		if (norm(Point2f(float(quad[2 * k]), float(quad[2 * k + 1])) - expected[0]) <= tol) First = k;
+	}
+	if (First < 0) return false;
+	bool Forward = true, Backward = true;
+	for (int j = 1; j < 4; ++j) {
+		const int F = (First + j) % 4, B = (First + 4 - j) % 4;
+		Forward = Forward && norm(Point2f(float(quad[2 * F]), float(quad[2 * F + 1])) - expected[j]) <= tol;
+		Backward = Backward && norm(Point2f(float(quad[2 * B]), float(quad[2 * B + 1])) - expected[j]) <= tol;
+	}
+	return Forward || Backward;
+}
+
+//Segments of the sides of a quad, as HoughLinesP gives them: each side in nb_pieces fragments with gaps,
+//short of the corners, jitter pixels of noise on the ends, only the [from, to] part of the side given by hidden
+void SideSegments(const Point2f quad[4], const int nb_pieces, const int jitter, mt19937 &rng, vector<Vec4i> &lines,
+				  const int hidden_side = -1, const float from = 0.0f, const float to = 1.0f)
+{
+	uniform_int_distribution<int> Jitter(-jitter, jitter);
+	for (int s = 0; s < 4; ++s) {
+		const Point2f A = quad[s], B = quad[(s + 1) % 4];
+		const float Begin = s == hidden_side ? from : 0.0f, End = s == hidden_side ? to : 1.0f;
+		for (int p = 0; p < nb_pieces; ++p) {
+			//Pieces of 90% of their share of the side, the last 5 pixels at the corners are missing
+			const float T0 = Begin + (End - Begin) * p / nb_pieces, T1 = T0 + 0.9f * (End - Begin) / nb_pieces;
+			const float Margin = 5.0f / float(norm(B - A));
+			const Point2f P0 = A + (B - A) * MAX(T0, Margin), P1 = A + (B - A) * MIN(T1, 1.0f - Margin);
+			lines.emplace_back(cvRound(P0.x) + Jitter(rng), cvRound(P0.y) + Jitter(rng), cvRound(P1.x) + Jitter(rng),
+							   cvRound(P1.y) + Jitter(rng));
+		}
+	}
+}
+
+void TestsLines()
+{
+	cout << "======================================" << endl;
+	cout << "============= Test Lines =============" << endl;
+
+	mt19937 Rng(42);
+	int Nb_failed = 0;
+	const auto Check = [&Nb_failed](const string &name, const bool ok) {
+		cout << name << " : \t" << (ok ? "OK" : "FAILED") << endl;
+		Nb_failed += !ok;
+	};
+	const auto Rotated = [](const Point2f &center, const float w, const float h, const float degrees, Point2f quad[4]) {
+		const float A = float(degrees * CV_PI / 180), C = cos(A), S = sin(A);
+		const Point2f Corners[4] = {Point2f(-w, -h), Point2f(w, -h), Point2f(w, h), Point2f(-w, h)};
+		for (int k = 0; k < 4; ++k) {
+			quad[k] = center + Point2f(C * Corners[k].x - S * Corners[k].y, S * Corners[k].x + C * Corners[k].y);
+		}
+	};
+	vector<Vec4i> Lines;
+	vector<Vec8i> Quads;
+
+	//Full rectangle
+	const Point2f Rect_doc[4] = {Point2f(100, 100), Point2f(500, 100), Point2f(500, 400), Point2f(100, 400)};
+	Lines.clear();
+	SideSegments(Rect_doc, 1, 0, Rng, Lines);
+	LinesToQuads(Lines, Quads);
+	Check("Full rectangle", Quads.size() == 1 && SameQuad(Quads[0], Rect_doc));
+
+	//Rotated document
+	Point2f Rotated_doc[4];
+	Rotated(Point2f(640, 480), 250, 180, 30, Rotated_doc);
+	Lines.clear();
+	SideSegments(Rotated_doc, 1, 0, Rng, Lines);
+	LinesToQuads(Lines, Quads);
+	Check("Rotated 30 degrees", Quads.size() == 1 && SameQuad(Quads[0], Rotated_doc));
+
+	//Collinear fragments with 1 pixel of noise on their ends, merged back into the 4 sides
+	Lines.clear();
+	SideSegments(Rotated_doc, 6, 1, Rng, Lines);
+	LinesToQuads(Lines, Quads);
+	Check("Collinear fragments", Quads.size() == 1 && SameQuad(Quads[0], Rotated_doc, 3.0f));
+
+	//Side partly hidden by a hand: 60% of it is still seen, the document is found
+	//With only 30% of the side the document isn't found (min_coverage 0.5)
+	Lines.clear();
+	SideSegments(Rect_doc, 1, 0, Rng, Lines, 2, 0.0f, 0.6f);
+	LinesToQuads(Lines, Quads);
+	Check("Side 60% hidden", Quads.size() == 1 && SameQuad(Quads[0], Rect_doc));
+	Lines.clear();
+	SideSegments(Rect_doc, 1, 0, Rng, Lines, 2, 0.35f, 0.65f);
+	LinesToQuads(Lines, Quads);
+	Check("Side 30% seen", Quads.empty());
+	Lines.clear();
+	SideSegments(Rect_doc, 3, 0, Rng, Lines, 1, 0.0f, 0.7f);
+	LinesToQuads(Lines, Quads);
+	Check("Hidden side in fragments", Quads.size() == 1 && SameQuad(Quads[0], Rect_doc));
+
+	//Two documents side by side, and a smaller one inside the first (dropped)
+	const Point2f Second_doc[4] = {Point2f(700, 150), Point2f(1100, 150), Point2f(1100, 700), Point2f(700, 700)},
+				  Inner_doc[4] = {Point2f(200, 200), Point2f(350, 200), Point2f(350, 300), Point2f(200, 300)};
+	Lines.clear();
+	SideSegments(Rect_doc, 1, 0, Rng, Lines);
+	SideSegments(Second_doc, 1, 0, Rng, Lines);
+	SideSegments(Inner_doc, 1, 0, Rng, Lines);
+	LinesToQuads(Lines, Quads);
+	Check("Two documents", Quads.size() == 2 && SameQuad(Quads[0], Second_doc) && SameQuad(Quads[1], Rect_doc));
+
+	//Noise segments around a rotated document
+	uniform_int_distribution<int> X(0, 1279), Y(0, 959), Length(5, 60);
+	uniform_real_distribution<float> Angle(0.0f, float(CV_PI));
+	Lines.clear();
+	SideSegments(Rotated_doc, 4, 1, Rng, Lines);
+	for (int n = 0; n < 300; ++n) {
+		const int X0 = X(Rng), Y0 = Y(Rng), L = Length(Rng);
+		const float A = Angle(Rng);
+		Lines.emplace_back(X0, Y0, X0 + cvRound(L * cos(A)), Y0 + cvRound(L * sin(A)));
+	}
+	LinesToQuads(Lines, Quads);
+	Check("300 noise segments", !Quads.empty() && SameQuad(Quads[0], Rotated_doc, 3.0f));
+
+	//Sides and corners exactly on the borders and on the corners of the cells of the spatial hash (32 pixels)
+	const Point2f Grid_doc[4] = {Point2f(64, 64), Point2f(320, 64), Point2f(320, 256), Point2f(64, 256)},
+				  Diamond_doc[4] = {Point2f(640, 128), Point2f(832, 320), Point2f(640, 512), Point2f(448, 320)};
+	Lines.clear();
+	for (int s = 0; s < 4; ++s) {
+		Lines.emplace_back(cvRound(Grid_doc[s].x), cvRound(Grid_doc[s].y), cvRound(Grid_doc[(s + 1) % 4].x),
+						   cvRound(Grid_doc[(s + 1) % 4].y));
+		Lines.emplace_back(cvRound(Diamond_doc[s].x), cvRound(Diamond_doc[s].y), cvRound(Diamond_doc[(s + 1) % 4].x),
+						   cvRound(Diamond_doc[(s + 1) % 4].y));
+	}
+	LinesToQuads(Lines, Quads);
+	Check("Corners on the grid", Quads.size() == 2 && SameQuad(Quads[0], Diamond_doc) && SameQuad(Quads[1], Grid_doc));
+
+	//Grid traversal: every cell the segment goes through (samples every 1/16 pixel), the cells beside a crossed corner,
+	//the walk ends in the cell of the end point
+	vector<Point> Cells;
+	GridCells(Point2f(16, 16), Point2f(112, 112), 32, Cells);
+	const vector<Point> Diagonal = {Point(0, 0), Point(1, 0), Point(0, 1), Point(1, 1), Point(2, 1), Point(1, 2),
+									Point(2, 2), Point(3, 2), Point(2, 3), Point(3, 3)};
+	Check("Diagonal through corners", Cells == Diagonal);
+	uniform_real_distribution<float> Coord(-100.0f, 1300.0f);
+	int Bad_walks = 0;
+	for (int t = 0; t < 10000; ++t) {
+		//One segment out of two with integer ends, on the borders of the cells more often
+		Point2f P0(Coord(Rng), Coord(Rng)), P1(Coord(Rng), Coord(Rng));
+		if (t % 2) {
+			P0 = Point2f(float(cvRound(P0.x / 8) * 8), float(cvRound(P0.y / 8) * 8));
+			P1 = Point2f(float(cvRound(P1.x / 8) * 8), float(cvRound(P1.y / 8) * 8));
+		}
+		GridCells(P0, P1, 32, Cells);
+		bool Good = Cells.back() == Point(cvFloor(P1.x / 32), cvFloor(P1.y / 32));
+		const int Nb_samples = 16 * int(norm(P1 - P0)) + 1;
+		for (int k = 0; k <= Nb_samples && Good; ++k) {
+			const Point2f P = P0 + (P1 - P0) * (float(k) / Nb_samples);
+			Good = find(Cells.begin(), Cells.end(), Point(cvFloor(P.x / 32), cvFloor(P.y / 32))) != Cells.end();
+		}
+		Bad_walks += !Good;
+	}
+	Check("10000 random walks", Bad_walks == 0);
+
+	cout << Nb_failed << " failed" << endl;
+	cout << "======================================" << endl << endl;
+}
+
+//Former exclusion of the nested candidates: every quad against every smaller one
+void ExcludeNestedPairwise(vector<ContourCandidate> &candidates, const double length_min, const double length_max)
+{
+	sort(candidates.begin(), candidates.end(), [](const ContourCandidate &a, const ContourCandidate &b) {
+		return a.Area > b.Area || (a.Area == b.Area && a.Id < b.Id);
+	});
+	for (size_t i = 0; i + 1 < candidates.size(); ++i) {
+		const ContourCandidate &Outer = candidates[i];
+		if (Outer.Id < 0 || Outer.Perimeter < length_min || Outer.Perimeter > length_max) continue;
+		for (size_t j = i + 1; j < candidates.size(); ++j) {
+			ContourCandidate &Inner = candidates[j];
+			if (Inner.Id >= 0 && Outer.Box.contains(Inner.Center) && inQuad(Outer.Quad, Inner.Center)) {
+				Inner.Id = -1;
+			}
+		}
+	}
+}
+
+//Random candidates: free quads, quads nested in a former one, duplicates and shifted copies
+void RandomCandidates(mt19937 &rng, const int nb, vector<ContourCandidate> &candidates)
+{
+	uniform_int_distribution<int> Pos(0, 1279), Half(4, 200), Jitter(-6, 6), Kind(0, 3);
+	uniform_real_distribution<double> Shrink(0.2, 1.0);
+	candidates.clear();
+	for (int Id = 0; Id < nb; ++Id) {
+		ContourCandidate C;
+		const int K = candidates.empty() ? 0 : Kind(rng);
+		if (K == 0) {
+			const Point Center(Pos(rng), Pos(rng) * 3 / 4);
+			const int W = Half(rng), H = Half(rng);
+			const Point Corners[4] = {Point(-W, -H), Point(-W, H), Point(W, H), Point(W, -H)};
+			for (int j = 0; j < 4; ++j) C.Quad[j] = Center + Corners[j] + Point(Jitter(rng), Jitter(rng));
+		}
+		else {
+			const ContourCandidate &From = candidates[rng() % candidates.size()];
+			const Point Sum = From.Quad[0] + From.Quad[1] + From.Quad[2] + From.Quad[3];
+			const Point Center(Sum.x / 4, Sum.y / 4);
+			const double S = K == 1 ? Shrink(rng) : 1.0;
+			const Point Shift = K == 3 ? Point(Jitter(rng) * 8, Jitter(rng) * 8) : Point(0, 0);
+			for (int j = 0; j < 4; ++j) {
+				C.Quad[j] = Center + Shift + Point(int(S * (From.Quad[j].x - Center.x)), int(S * (From.Quad[j].y - Center.y)));
+			}
+		}
+		C.Id = Id;
+		C.Area = contourArea(_InputArray(C.Quad, 4));
+		C.Perimeter = arcLength(_InputArray(C.Quad, 4), true);
+		const Point Sum = C.Quad[0] + C.Quad[1] + C.Quad[2] + C.Quad[3];
+		C.Center = Point(Sum.x / 4, Sum.y / 4);
+		C.Box = boundingRect(_InputArray(C.Quad, 4));
+		candidates.push_back(C);
+	}
+}
+
+void TestsNesting()
+{
+	cout << "======================================" << endl;
+	cout << "========= Test Nesting Tables ========" << endl;
+
+	//Same nested and duplicate quads rejected as the former pairwise exclusion, in the same order
+	const int Nb_sets = 3000;
+	const double Length_min = 100, Length_max = 1200;
+	mt19937 Rng(42);
+	vector<ContourCandidate> Swept, Pairwise;
+	vector<int> Index;
+	int Nb_diff = 0, Nb_rejected = 0;
+	for (int t = 0; t < Nb_sets; ++t) {
+		RandomCandidates(Rng, 2 + int(Rng() % 300), Swept);
+		Pairwise = Swept;
+		ExcludeNested(Swept, Index, Length_min, Length_max);
+		ExcludeNestedPairwise(Pairwise, Length_min, Length_max);
+		bool Same = true;
+		for (size_t i = 0; i < Swept.size(); ++i) {
+			Same = Same && Swept[i].Id == Pairwise[i].Id;
+			Nb_rejected += Pairwise[i].Id < 0;
+		}
+		Nb_diff += !Same;
+	}
+	cout << "Random sets : 	" << Nb_diff << " / " << Nb_sets << " different from the pairwise exclusion (" << Nb_rejected
+		 << " quads rejected)" << endl;
+
+	//Synthetic table: a white page cut in G x G cells by black lines, each cell survives as a quad
+	const int Nb_frames = 10, Width = 1280, Height = 960, Margin = 40;
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	Params.ratioLengthMin = 0.005;
+	DetectorSession Session(Width, Height, Params);
+	vector<vector<Point>> Docs;
+
+	ofstream File;
+	File.open(PATH + "NestingDuration.csv");
+	File << "Cells;Detection (ms);Docs\n";
+	for (const int G : {8, 16, 32, 64}) {
+		Mat Table(Height, Width, CV_8UC3, COLORS[0]);
+		rectangle(Table, Point(Margin, Margin), Point(Width - Margin, Height - Margin), COLORS[2], CV_FILLED);
+		for (int k = 0; k <= G; ++k) {
+			const int X = Margin + k * (Width - 2 * Margin) / G, Y = Margin + k * (Height - 2 * Margin) / G;
+			line(Table, Point(X, 0), Point(X, Height), COLORS[0], 3);
+			line(Table, Point(0, Y), Point(Width, Y), COLORS[0], 3);
+		}
+		const auto T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) {
+			DocsDetection(Session, Table, Docs);
+		}
+		const duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+		cout << G * G << " cells : \t" << Fp_ms.count() / Nb_frames << " ms\t(" << Docs.size() << " docs)" << endl;
+		File << G * G << ";" << Fp_ms.count() / Nb_frames << ";" << Docs.size() << "\n";
+	}
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
+void TestsDepth()
+{
+	cout << "======================================" << endl;
+	cout << "========= Test Contour Depth =========" << endl;
+
+	//Synthetic text page: the letters have the background color, each one is a contour under the document
+	const int Nb_frames = 10, Width = 1280, Height = 960, Margin = 80;
+	Mat Page(Height, Width, CV_8UC3, COLORS[0]);
+	rectangle(Page, Point(Margin, Margin), Point(Width - Margin, Height - Margin), COLORS[2], CV_FILLED);
+	for (int Y = Margin + 30; Y < Height - Margin - 10; Y += 22) {
+		putText(Page, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor",
+				Point(Margin + 15, Y), FONT_HERSHEY_SIMPLEX, 0.55, COLORS[0], 2);
+	}
+	DetectorParams Params;
+	GetDefaultDetectorParams(&Params);
+	DetectorSession Session(Width, Height, Params);
+	vector<vector<Point>> Docs;
+
+	ofstream File;
+	File.open(PATH + "DepthDuration.csv");
+	File << "Depth;Contours;Detection (ms);Docs\n";
+	for (const int Depth : {0, 4, 3, 2, 1}) {
+		Params.contourDepth = Depth;
+		Session.SetParams(Params);
+		const auto T1 = high_resolution_clock::now();
+		for (int f = 0; f < Nb_frames; ++f) {
+			DocsDetection(Session, Page, Docs);
+		}
+		const duration<double, std::milli> Fp_ms = high_resolution_clock::now() - T1;
+		cout << "Depth " << Depth << " : \t" << Session._Raw.Size() << " contours\t" << Fp_ms.count() / Nb_frames
+			 << " ms\t(" << Docs.size() << " docs)" << endl;
+		File << Depth << ";" << Session._Raw.Size() << ";" << Fp_ms.count() / Nb_frames << ";" << Docs.size() << "\n";
+	}
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
+void TestsBatch()
+{
+	cout << "======================================" << endl;
+	cout << "========== Test Batch Images =========" << endl;
+
+	const int Nb_copies = 10;
+	vector<Mat> Srcs;
+	for (const string &Name : NAMES) {
+		const Mat Src = imread(PATH + Name + EXT, CV_LOAD_IMAGE_COLOR);
+		if (Src.cols == 0 || Src.rows == 0) continue;
+		for (int c = 0; c < Nb_copies; ++c) Srcs.push_back(Src);
+	}
+	if (Srcs.empty()) return;
+	vector<vector<vector<Point>>> Contours;
+	vector<int> Errors;
+
+	ofstream File;
+	File.open(PATH + "BatchThroughput.csv");
+	File << "Threads;Images per second;Speedup\n";
+	const int Nb_cores = WorkersCount(0);
+	double Throughput_1 = 0.0;
+	for (int t = 1; t <= Nb_cores; ++t) {
+		const auto T1 = high_resolution_clock::now();
+		const int Error = DocsDetectionBatch(Srcs, COLORS[0], Contours, Errors, t);
+		const duration<double> Fp_s = high_resolution_clock::now() - T1;
+		if (Error != NO_ERRORS) {
+			cout << "Failed images : " << count_if(Errors.begin(), Errors.end(), [](const int e) { return e != NO_ERRORS; }) << endl;
+		}
+		const double Throughput = Srcs.size() / Fp_s.count();
+		if (t == 1) Throughput_1 = Throughput;
+		cout << t << " threads : \t" << Throughput << " images/s (x" << Throughput / Throughput_1 << ")" << endl;
+		File << t << ";" << Throughput << ";" << Throughput / Throughput_1 << "\n";
+	}
+	File.close();
+	cout << "======================================" << endl << endl;
+}
+
 void TestsReco()
 {
 	const int num_im = 10;
 	const string Path = PATH + "Reco_Tests/";
-	Im_Features F[num_im];
+	DocFeatures F[num_im];
 
 	for(int i = 0; i < num_im; ++i) {
 		cout << "==============================" << endl;
@@ -602,10 +2486,32 @@ int main(int argc, char *argv[])
 		TestsEdge(i);
 		TestsContour(i);
 		//TestsDLLFunction(i);
+		//TestsSession(i);
+		//TestsMask(i);
+		//TestsPyramid(i);
+		//TestsTracking(i);
+		//TestsAsync(i);
+		//TestsClutter(i);
+		//TestsCorners(i);
+		//TestsColorTable(i);
+		//TestsFusedEdge(i);
+		//TestsBands(i);
+		//TestsRectify(i);
+		//TestsQuadFeatures(i);
+		//TestsFeatures(i);
 	}
 	SaveCSV(NAMES.size());
 
 	//TestsReco();
+	//TestsBatch();
+	//TestsLines();
+	//TestsNesting();
+	//TestsDepth();
+	//TestsDistance();
+	//TestsMatch();
+	//TestsIndex();
+	//TestsPQ();
+	//TestsCascade();
 	cout << endl << "That's all Folks !" << endl;
 	_getch();
 	return EXIT_SUCCESS;
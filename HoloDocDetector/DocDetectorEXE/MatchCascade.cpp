@@ -0,0 +1,96 @@
+#include "MatchCascade.hpp"
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+template <typename Features>
+MatchCascade<Features>::MatchCascade(const int near_radius, const double min_similarity, const FeaturesCoefs &coefs)
+	: _Near_radius(MAX(near_radius, 0)), _Max_dist(float((1.0 - min_similarity / 100.0) * sqrt(2.0))),
+	  _Index(16, 128, 64, coefs)
+{
+}
+
+template <typename Features>
+void MatchCascade<Features>::Extract(const Mat &doc, uint64 &hash, Features &features, const int nb_threads)
+{
+	features.ExtractFeatures(doc, nb_threads);
+	hash = PerceptualHash(doc);
+}
+
+template <typename Features>
+void MatchCascade<Features>::Insert(const int id, const uint64 hash, const Features &features)
+{
+	_Hashes.Insert(id, hash);
+	_Index.Insert(id, features);
+}
+
+template <typename Features>
+void MatchCascade<Features>::Insert(const int id, const Mat &doc)
+{
+	uint64 Hash;
+	Features F;
+	Extract(doc, Hash, F);
+	Insert(id, Hash, F);
+}
+
+template <typename Features>
+bool MatchCascade<Features>::Remove(const int id)
+{
+	_Hashes.Remove(id);
+	return _Index.Remove(id);
+}
+
+template <typename Features>
+void MatchCascade<Features>::Clear()
+{
+	_Hashes.Clear();
+	_Index.Clear();
+}
+
+template <typename Features>
+CASCADE_STAGE MatchCascade<Features>::Match(const uint64 hash, const Features &features, int &id, double &similarity) const
+{
+	id = -1;
+	similarity = 0.0;
+
+	//Hash stage: the best of the near hashes, on the features
+	vector<pair<int, int>> Near;
+	_Hashes.Search(hash, _Near_radius, Near);
+	float Best = FLT_MAX, Dist;
+	int Best_id = -1;
+	for (const pair<int, int> &Hit : Near) {
+		if (_Index.Distance(features, Hit.second, Dist) && Dist < Best) {
+			Best = Dist;
+			Best_id = Hit.second;
+		}
+	}
+	if (Best <= _Max_dist) {
+		id = Best_id;
+		similarity = (1.0 - Best / sqrt(2.0)) * 100.0;
+		return CASCADE_HASH;
+	}
+
+	//Index stage
+	vector<int> Ids;
+	vector<float> Dists;
+	_Index.Search(features, 1, Ids, Dists);
+	if (Ids.empty()) return CASCADE_NEW;
+	similarity = (1.0 - Dists[0] / sqrt(2.0)) * 100.0;
+	if (Dists[0] > _Max_dist) return CASCADE_NEW;
+	id = Ids[0];
+	return CASCADE_INDEX;
+}
+
+template <typename Features>
+CASCADE_STAGE MatchCascade<Features>::Match(const Mat &doc, int &id, double &similarity) const
+{
+	uint64 Hash;
+	Features F;
+	Extract(doc, Hash, F);
+	return Match(Hash, F, id, similarity);
+}
+
+//***** Layouts *****
+template class MatchCascade<DocFeatures>;
+template class MatchCascade<ServerFeatures>;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "FeaturesIndex.hpp"
+#include "PerceptualHash.hpp"
+
+//Stage of the cascade that decided a match
+enum CASCADE_STAGE
+{
+	CASCADE_NEW = 0,	// No document close enough: a new one
+	CASCADE_HASH,		// Near hash, verified on the features
+	CASCADE_INDEX,		// Ambiguous hash, found by the features index
+};
+
+//Match of a document against the known ones in two stages
+//Hash stage: the documents whose perceptual hash is within near_radius of the query (a document seen again) are verified
+//on their features, only the best one is kept
+//Index stage: the queries without a verified near hash fall through to the features index
+//The verification bounds the hash stage: on the synthetic documents of TestsCascade 95% of the documents seen again are
+//within 8 bits, but only about half are verified at a min_similarity of 80 (lighting changes the histograms)
+template <typename Features>
+class MatchCascade
+{
+public:
+	//near_radius: largest Hamming distance of a document seen again, min_similarity: smallest Distance of a match (in [0, 100])
+	explicit MatchCascade(int near_radius = 8, double min_similarity = 80.0, const FeaturesCoefs &coefs = Features::DefaultCoefs());
+
+	//Perceptual hash and features of a rectified document
+	static void Extract(const cv::Mat &doc, uint64 &hash, Features &features, int nb_threads = 1);
+	//Add a document, or update it if id is already known
+	void Insert(int id, uint64 hash, const Features &features);
+	void Insert(int id, const cv::Mat &doc);
+	//False if id isn't known
+	bool Remove(int id);
+	//The document matching the query, id is -1 for a new one (similarity is then the one of the closest document, or 0)
+	CASCADE_STAGE Match(uint64 hash, const Features &features, int &id, double &similarity) const;
+	CASCADE_STAGE Match(const cv::Mat &doc, int &id, double &similarity) const;
+	//Candidates of a search of the features index (see FeaturesIndex)
+	void SetSearch(int ef_search) { _Index.SetSearch(ef_search); }
+	int Size() const { return _Index.Size(); }
+	void Clear();
+
+private:
+	int _Near_radius;
+	float _Max_dist;	// Distance of min_similarity (see MatchTopK)
+	HashIndex _Hashes;
+	FeaturesIndex<Features> _Index;
+};
+
+typedef MatchCascade<DocFeatures> DocCascade;
+typedef MatchCascade<ServerFeatures> ServerCascade;
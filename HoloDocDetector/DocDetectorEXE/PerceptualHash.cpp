@@ -0,0 +1,104 @@
+#include "PerceptualHash.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+const int HASH_THUMB = 32, HASH_SIDE = 8;	// Thumbnail side, side of the frequencies kept (64 bits)
+
+uint64 PerceptualHash(const Mat &doc)
+{
+	if (doc.empty()) return 0;
+
+	//Luma thumbnail, area averaging
+	Mat Gray, Thumb, Freq;
+	if (doc.channels() == 3) cvtColor(doc, Gray, COLOR_BGR2GRAY);
+	else if (doc.channels() == 4) cvtColor(doc, Gray, COLOR_BGRA2GRAY);
+	else Gray = doc;
+	resize(Gray, Thumb, Size(HASH_THUMB, HASH_THUMB), 0, 0, INTER_AREA);
+	Thumb.convertTo(Thumb, CV_32F);
+	dct(Thumb, Freq);
+
+	//Lowest frequencies without the DC row and column (mean luma and flat gradients), compared to their median
+	float Low[HASH_SIDE * HASH_SIDE], Sorted[HASH_SIDE * HASH_SIDE];
+	for (int y = 0; y < HASH_SIDE; ++y) {
+		const float *F = Freq.ptr<float>(y + 1) + 1;
+		for (int x = 0; x < HASH_SIDE; ++x) Low[y * HASH_SIDE + x] = F[x];
+	}
+	const int Half = HASH_SIDE * HASH_SIDE / 2;
+	copy_n(Low, HASH_SIDE * HASH_SIDE, Sorted);
+	nth_element(Sorted, Sorted + Half, Sorted + HASH_SIDE * HASH_SIDE);
+	const float Median = (*max_element(Sorted, Sorted + Half) + Sorted[Half]) / 2;
+
+	uint64 Hash = 0;
+	for (int i = 0; i < HASH_SIDE * HASH_SIDE; ++i) {
+		if (Low[i] > Median) Hash |= uint64(1) << i;
+	}
+	return Hash;
+}
+
+int HammingDistance(const uint64 a, const uint64 b)
+{
+	//Population count by pairs, nibbles, then bytes summed by the multiplication
+	uint64 X = a ^ b;
+	X -= (X >> 1) & 0x5555555555555555ULL;
+	X = (X & 0x3333333333333333ULL) + ((X >> 2) & 0x3333333333333333ULL);
+	X = (X + (X >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return int((X * 0x0101010101010101ULL) >> 56);
+}
+
+//***** HashIndex *****
+void HashIndex::Clear()
+{
+	_Hashes.clear();
+	for (auto &Table : _Tables) Table.clear();
+}
+
+void HashIndex::Insert(const int id, const uint64 hash)
+{
+	Remove(id);
+	_Hashes[id] = hash;
+	for (int s = 0; s < _Substrings; ++s) _Tables[s][substring(hash, s)].push_back(id);
+}
+
+bool HashIndex::Remove(const int id)
+{
+	const auto Hash = _Hashes.find(id);
+	if (Hash == _Hashes.end()) return false;
+	for (int s = 0; s < _Substrings; ++s) {
+		const auto Bucket = _Tables[s].find(substring(Hash->second, s));
+		vector<int> &Ids = Bucket->second;
+		Ids.erase(find(Ids.begin(), Ids.end(), id));
+		if (Ids.empty()) _Tables[s].erase(Bucket);
+	}
+	_Hashes.erase(Hash);
+	return true;
+}
+
+void HashIndex::searchTable(const int s, const int value, const int radius, const int first, vector<int> &candidates) const
+{
+	const auto Bucket = _Tables[s].find(value);
+	if (Bucket != _Tables[s].end()) candidates.insert(candidates.end(), Bucket->second.begin(), Bucket->second.end());
+	if (radius == 0) return;
+	for (int b = first; b < _Substring_bits; ++b) searchTable(s, value ^ (1 << b), radius - 1, b + 1, candidates);
+}
+
+void HashIndex::Search(const uint64 hash, const int radius, vector<pair<int, int>> &found) const
+{
+	found.clear();
+	if (radius < 0 || _Hashes.empty()) return;
+
+	//Candidates: one substring within radius / 4, the same document can be in several tables
+	const int Sub_radius = MIN(radius / _Substrings, _Substring_bits);
+	vector<int> Candidates;
+	for (int s = 0; s < _Substrings; ++s) searchTable(s, substring(hash, s), Sub_radius, 0, Candidates);
+	sort(Candidates.begin(), Candidates.end());
+	Candidates.erase(unique(Candidates.begin(), Candidates.end()), Candidates.end());
+
+	for (const int Id : Candidates) {
+		const int Dist = HammingDistance(hash, _Hashes.at(Id));
+		if (Dist <= radius) found.emplace_back(Dist, Id);
+	}
+	sort(found.begin(), found.end());
+}
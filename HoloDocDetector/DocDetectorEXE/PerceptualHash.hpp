@@ -0,0 +1,40 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//64-bit perceptual hash of a rectified document (DCT pHash)
+//Luma thumbnail of 32x32, DCT, the 8x8 lowest frequencies without the DC row and column, one bit by value above their median
+//A document seen again differs by 4 bits (median, 8 for 90% of them), unrelated ones by 32 (at least 18 on 2000 pairs)
+uint64 PerceptualHash(const cv::Mat &doc);
+int HammingDistance(uint64 a, uint64 b);
+
+//Multi-index hash table: the hashes within a Hamming radius of a query without comparing it to all of them
+//Each hash is split in 4 substrings of 16 bits, indexed by a table each
+//Two hashes within r of each other have one substring within r / 4 (pigeonhole): only the buckets of the substrings within
+//r / 4 of the query are read, then the candidates are checked on their whole hash
+//The buckets read grow fast with r / 4 (697 a table for r = 12): past a radius of about 8 a scan of the hashes is faster
+class HashIndex
+{
+public:
+	static const int _Substrings = 4, _Substring_bits = 16;
+
+	//Add a document, or update it if id is already in the index
+	void Insert(int id, uint64 hash);
+	//False if id isn't in the index
+	bool Remove(int id);
+	//Documents within radius of hash, closest first (Hamming distance, id)
+	void Search(uint64 hash, int radius, std::vector<std::pair<int, int>> &found) const;
+	int Size() const { return int(_Hashes.size()); }
+	void Clear();
+
+private:
+	std::unordered_map<int, uint64> _Hashes;						// Hash of each document
+	std::unordered_map<int, std::vector<int>> _Tables[_Substrings];	// Documents of each value of a substring
+
+	static int substring(uint64 hash, int s) { return int(hash >> (s * _Substring_bits)) & 0xFFFF; }
+	//Documents of the buckets of table s whose value is within radius of value (bits flipped from first on)
+	void searchTable(int s, int value, int radius, int first, std::vector<int> &candidates) const;
+};
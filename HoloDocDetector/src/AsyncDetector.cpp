@@ -0,0 +1,115 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "AsyncDetector.hpp"
+
+using namespace std;
+using namespace cv;
+
+//*****************************
+//****** Async Detector *******
+AsyncDetector::AsyncDetector(const uint width, const uint height, const DetectorParams &params)
+	: _Nb_dropped(0), _Session(width, height, params), _Stop(false)
+{
+	_Worker = thread(&AsyncDetector::Run, this);
+}
+
+AsyncDetector::~AsyncDetector()
+{
+	{
+		lock_guard<mutex> Lock(_Mutex);
+		_Stop = true;
+	}
+	_Wake.notify_one();
+	_Worker.join();
+}
+
+void AsyncDetector::Submit(const Color32 *image, const uint width, const uint height, const int frame_id)
+{
+	//The slot keeps its buffer, no allocation while the resolution doesn't change
+	AsyncFrame &Frame = _Frames.Back();
+	Frame._Pixels.assign(image, image + size_t(width) * height);
+	Frame._Width = width;
+	Frame._Height = height;
+	Frame._Id = frame_id;
+	if (_Frames.Publish()) _Nb_dropped++;
+	//Empty lock so the worker can't miss the notification between its check and its wait
+	{ lock_guard<mutex> Lock(_Mutex); }
+	_Wake.notify_one();
+}
+
+const AsyncResult *AsyncDetector::TryGet()
+{
+	return _Results.Update() ? &_Results.Front() : nullptr;
+}
+
+void AsyncDetector::Run()
+{
+	while (true) {
+		{
+			unique_lock<mutex> Lock(_Mutex);
+			_Wake.wait(Lock, [this] { return _Stop || _Frames.HasNew(); });
+			if (_Stop) return;
+		}
+		_Frames.Update();
+		AsyncFrame &Frame = _Frames.Front();
+
+		AsyncResult &Result = _Results.Back();
+		Result._Id = Frame._Id;
+		Result._ErrCode = TrackDocs(_Session, Frame._Pixels.data(), Frame._Width, Frame._Height);
+		Result._Docs.resize(Result._ErrCode == NO_ERRORS ? _Session._Nb_contours : 0);
+		for (size_t i = 0; i < Result._Docs.size(); ++i) {
+			for (int j = 0; j < 4; ++j) {
+				Result._Docs[i][2 * j] = _Session._Contours[i][j].x;
+				Result._Docs[i][2 * j + 1] = _Session._Contours[i][j].y;
+			}
+		}
+		_Results.Publish();
+	}
+}
+//*****************************
+
+//********************************
+//********** Unity Link **********
+DLL_EXPORT CreateAsyncDetector(uint width, uint height, DetectorParams params, AsyncDetector **outSession)
+{
+	if (outSession == nullptr) return INVALID_SESSION;
+	if (width == 0 || height == 0) return EMPTY_MAT;
+	*outSession = new AsyncDetector(width, height, params);
+	return NO_ERRORS;
+}
+
+DLL_EXPORT DestroyAsyncDetector(AsyncDetector *session)
+{
+	if (session == nullptr) return INVALID_SESSION;
+	delete session;
+	return NO_ERRORS;
+}
+
+DLL_EXPORT SubmitFrame(AsyncDetector *session, Color32 *image, uint width, uint height, int frameId)
+{
+	if (session == nullptr) return INVALID_SESSION;
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	session->Submit(image, width, height, frameId);
+	return NO_ERRORS;
+}
+
+DLL_EXPORT TryGetResult(AsyncDetector *session, int *outFrameId, uint *outDocsCount, int *outDocsPoints)
+{
+	if (session == nullptr) return INVALID_SESSION;
+	const AsyncResult *Result = session->TryGet();
+	if (Result == nullptr) return NO_RESULT;
+	*outFrameId = Result->_Id;
+	*outDocsCount = uint(Result->_Docs.size());
+	for (size_t i = 0; i < Result->_Docs.size(); ++i) {
+		for (int j = 0; j < 8; ++j) {
+			outDocsPoints[8 * i + j] = Result->_Docs[i][j];
+		}
+	}
+	return Result->_ErrCode;
+}
+//********************************
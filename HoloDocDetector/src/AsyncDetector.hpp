@@ -0,0 +1,127 @@
+#pragma once
+
+#include "DocDetector.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//********************************
+//******** Triple Buffer *********
+//********************************
+/// <summary>
+/// Lock-free single producer / single consumer ring of 3 slots that only keeps the latest value.
+/// The producer fills Back() then publishes it, the consumer takes the last published slot with Update() and reads Front().
+/// A value published before the previous one was taken is dropped (the consumer always gets the newest one).
+/// </summary>
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : _Back(0), _Front(1), _Middle(2) {}
+
+	T &Back() { return _Slots[_Back]; }
+	T &Front() { return _Slots[_Front]; }
+
+	/// <summary>Publish the back slot.</summary>
+	/// <returns><c>True</c> if a value not taken yet was dropped, <c>False</c> if not</returns>
+	bool Publish()
+	{
+		const int Old = _Middle.exchange(_Back | NEW_VALUE);
+		_Back = Old & INDEX;
+		return (Old & NEW_VALUE) != 0;
+	}
+
+	/// <summary>Take the last published slot as front slot.</summary>
+	/// <returns><c>True</c> if there was a new value, <c>False</c> if not</returns>
+	bool Update()
+	{
+		if ((_Middle.load() & NEW_VALUE) == 0) return false;
+		_Front = _Middle.exchange(_Front) & INDEX;
+		return true;
+	}
+
+	bool HasNew() const { return (_Middle.load() & NEW_VALUE) != 0; }
+
+private:
+	static const int INDEX = 3, NEW_VALUE = 4;
+	T _Slots[3];
+	int _Back, _Front;			// Owned by the producer and the consumer
+	std::atomic<int> _Middle;	// Shared slot index with the NEW_VALUE flag
+};
+
+//********************************
+//******** Async Detector ********
+//********************************
+/// <summary>Frame copied from Unity.</summary>
+struct AsyncFrame
+{
+	std::vector<Color32> _Pixels;
+	uint _Width, _Height;
+	int _Id;
+};
+
+/// <summary>Documents found on a frame.</summary>
+struct AsyncResult
+{
+	std::vector<cv::Vec8i> _Docs;
+	int _Id, _ErrCode;
+};
+
+/// <summary>
+/// Detection on a worker thread: Unity submits the frames and polls the results without waiting for the detection.
+/// The worker owns its session and tracks the documents (<see cref = "TrackDocs"/>), pending frames are dropped when a newer one arrives.
+/// </summary>
+class AsyncDetector
+{
+public:
+	AsyncDetector(uint width, uint height, const DetectorParams &params);
+	AsyncDetector(const AsyncDetector &) = delete;
+	AsyncDetector &operator=(const AsyncDetector &) = delete;
+	virtual ~AsyncDetector();
+
+	/// <summary>Copy the frame for the worker (never waits for it).</summary>
+	void Submit(const Color32 *image, uint width, uint height, int frame_id);
+
+	/// <summary>Last result not read yet.</summary>
+	/// <returns>Result or nullptr if there is no new one (valid until the next call).</returns>
+	const AsyncResult *TryGet();
+
+	std::atomic<int> _Nb_dropped;	// Frames never processed
+
+private:
+	DetectorSession _Session;		// Only used by the worker
+	TripleBuffer<AsyncFrame> _Frames;
+	TripleBuffer<AsyncResult> _Results;
+	std::atomic<bool> _Stop;
+	std::mutex _Mutex;				// Only to sleep when there is no frame
+	std::condition_variable _Wake;
+	std::thread _Worker;
+
+	void Run();
+};
+
+//********************************
+//********** Unity Link **********
+//********************************
+/// <summary>Create an asynchronous detector and its worker thread.</summary>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="params">Detection parameters.</param>
+/// <param name="outSession">The created detector (to release with DestroyAsyncDetector).</param>
+DLL_EXPORT CreateAsyncDetector(uint width, uint height, DetectorParams params, AsyncDetector **outSession);
+
+DLL_EXPORT DestroyAsyncDetector(AsyncDetector *session);
+
+/// <summary>Give a frame to the worker, the image can be reused as soon as the function returns.</summary>
+/// <param name="session">Asynchronous detector.</param>
+/// <param name="image">Unity image.</param>
+/// <param name="frameId">Id given back with the result.</param>
+DLL_EXPORT SubmitFrame(AsyncDetector *session, Color32 *image, uint width, uint height, int frameId);
+
+/// <summary>Get the newest result.</summary>
+/// <param name="session">Asynchronous detector.</param>
+/// <param name="outFrameId">Id of the frame the documents come from.</param>
+/// <param name="out">Documents definition for Unity.</param>
+/// <return>NO_RESULT if there is no new result, the error code of the detection otherwise.</return>
+DLL_EXPORT TryGetResult(AsyncDetector *session, int *outFrameId, uint *outDocsCount, int *outDocsPoints);
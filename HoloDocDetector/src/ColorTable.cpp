@@ -0,0 +1,89 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "ColorTable.hpp"
+#include <cstring>
+
+using namespace std;
+using namespace cv;
+
+//*****************************
+//******** Color Table ********
+void ColorTable::Clear()
+{
+	memset(_Bits, 0, sizeof(_Bits));
+}
+
+bool ColorTable::Empty() const
+{
+	for (const uint32_t Word : _Bits) {
+		if (Word != 0) return false;
+	}
+	return true;
+}
+
+void ColorTable::AddBox(const Scalar &lower, const Scalar &higher)
+{
+	//Cells [first, last] by channel (RGB order), at least the cell of the middle of the box
+	int First[3], Last[3];
+	for (int c = 0; c < 3; ++c) {
+		const double Lo = lower[2 - c], Hi = higher[2 - c];
+		if (Hi < Lo) return;
+		const int Step = 1 << SHIFT;
+		First[c] = MAX(0, cvCeil((Lo - Step / 2) / Step));
+		Last[c] = MIN(CELLS - 1, cvFloor((Hi - Step / 2) / Step));
+		if (First[c] > Last[c]) {
+			First[c] = Last[c] = MIN(CELLS - 1, MAX(0, cvRound((Lo + Hi) / 2)) >> SHIFT);
+		}
+	}
+	//One mask of b cells for every (r, g) word
+	const uint32_t Mask = (Last[2] == 31 ? 0xFFFFFFFFu : (1u << (Last[2] + 1)) - 1) & ~((1u << First[2]) - 1);
+	for (int r = First[0]; r <= Last[0]; ++r) {
+		for (int g = First[1]; g <= Last[1]; ++g) {
+			_Bits[(r << 5) | g] |= Mask;
+		}
+	}
+}
+
+void ColorTable::AddSamples(const Mat &src)
+{
+	if (src.type() != CV_8UC3) return;
+	for (int y = 0; y < src.rows; ++y) {
+		const uchar *P = src.ptr<uchar>(y);
+		for (int x = 0; x < src.cols; ++x, P += 3) {
+			Set(P[2] >> SHIFT, P[1] >> SHIFT, P[0] >> SHIFT);
+		}
+	}
+}
+
+void ColorTable::Dilate(const int radius)
+{
+	if (radius <= 0) return;
+	//Past CELLS - 1 cells every axis is covered (and a shift of a word by 32 is undefined)
+	const int Radius = MIN(radius, CELLS - 1);
+	//b axis: shifts of the words, then r and g axes: or of the neighbour words
+	uint32_t Tmp[CELLS * CELLS];
+	for (uint32_t &Word : _Bits) {
+		uint32_t D = Word;
+		for (int k = 1; k <= Radius; ++k) D |= (Word << k) | (Word >> k);
+		Word = D;
+	}
+	for (int axis = 0; axis < 2; ++axis) {
+		memcpy(Tmp, _Bits, sizeof(_Bits));
+		for (int r = 0; r < CELLS; ++r) {
+			for (int g = 0; g < CELLS; ++g) {
+				uint32_t D = 0;
+				for (int k = -Radius; k <= Radius; ++k) {
+					const int Rk = axis == 0 ? r + k : r, Gk = axis == 0 ? g : g + k;
+					if (0 <= Rk && Rk < CELLS && 0 <= Gk && Gk < CELLS) D |= Tmp[(Rk << 5) | Gk];
+				}
+				_Bits[(r << 5) | g] = D;
+			}
+		}
+	}
+}
+//*****************************
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+
+//*******************************
+//********* Color Table *********
+//*******************************
+/// <summary>
+/// Set of background colors on a 32 x 32 x 32 grid (8 levels by cell and by channel), one bit by cell (4 KB).
+/// Any shape of background can be represented (several colors, a learned region...)
+/// and a pixel is classified with one lookup.
+/// </summary>
+class ColorTable
+{
+public:
+	static const int CELLS = 32,	// Cells by channel
+					 SHIFT = 3;		// 256 / CELLS = 1 << SHIFT levels by cell
+
+	ColorTable() { Clear(); }
+
+	/// <summary>Remove all the colors.</summary>
+	void Clear();
+
+	/// <summary><c>True</c> if no color is in the table.</summary>
+	bool Empty() const;
+
+	/// <summary>Add the cells with their center in a color box.</summary>
+	/// <param name="lower">The lower color (BGR like OpenCV).</param>
+	/// <param name="higher">The higher color (BGR like OpenCV).</param>
+	void AddBox(const cv::Scalar &lower, const cv::Scalar &higher);
+
+	/// <summary>Add the cells of the pixels of an image (a region of the background).</summary>
+	/// <param name="src">tri-channel 8-bit image (BGR).</param>
+	void AddSamples(const cv::Mat &src);
+
+	/// <summary>Add the neighbours of the cells (tolerance of the learned colors).</summary>
+	/// <param name="radius">Radius in cells on each channel.</param>
+	void Dilate(int radius);
+
+	/// <summary>Verify if a color is in the table.</summary>
+	bool Contains(const uchar r, const uchar g, const uchar b) const
+	{
+		return ((_Bits[((r >> SHIFT) << 5) | (g >> SHIFT)] >> (b >> SHIFT)) & 1) != 0;
+	}
+
+private:
+	uint32_t _Bits[CELLS * CELLS];	// Word (r, g), bit b
+
+	void Set(int r, int g, int b) { _Bits[(r << 5) | g] |= 1u << b; }
+};
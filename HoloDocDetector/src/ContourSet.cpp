@@ -0,0 +1,148 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "ContourSet.hpp"
+#include <opencv2/core/types_c.h>
+#include <opencv2/core/core_c.h>
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+//*****************************
+//******** Contour Set ********
+ContourSet::ContourSet() : _Offsets(1, 0) {}
+
+void ContourSet::Clear()
+{
+	_X.clear();
+	_Y.clear();
+	_Offsets.resize(1);
+}
+
+int ContourSet::Grow(const int count)
+{
+	const int Begin = _Offsets.back();
+	_X.resize(Begin + count);
+	_Y.resize(Begin + count);
+	_Offsets.push_back(Begin + count);
+	return Begin;
+}
+
+void ContourSet::Add(const CvSeq *seq)
+{
+	const int Begin = Grow(seq->total);
+	int *X = _X.data() + Begin, *Y = _Y.data() + Begin;
+	CvSeqReader Reader;
+	cvStartReadSeq(seq, &Reader);
+	for (int k = 0; k < seq->total; ++k) {
+		CvPoint P;
+		CV_READ_SEQ_ELEM(P, Reader);
+		X[k] = P.x;
+		Y[k] = P.y;
+	}
+}
+
+void ContourSet::Add(const Point *points, const int count)
+{
+	const int Begin = Grow(count);
+	int *X = _X.data() + Begin, *Y = _Y.data() + Begin;
+	for (int k = 0; k < count; ++k) {
+		X[k] = points[k].x;
+		Y[k] = points[k].y;
+	}
+}
+
+void ContourSet::RemoveLast()
+{
+	if (Size() == 0) return;
+	_Offsets.pop_back();
+	_X.resize(_Offsets.back());
+	_Y.resize(_Offsets.back());
+}
+
+void ContourSet::Reverse()
+{
+	//Everything reversed: the contour j is then in [Total - _Offsets[j + 1], Total - _Offsets[j])
+	const int Total = _Offsets.back();
+	reverse(_X.begin(), _X.end());
+	reverse(_Y.begin(), _Y.end());
+	reverse(_Offsets.begin(), _Offsets.end());
+	for (int &Offset : _Offsets) Offset = Total - Offset;
+	//Points of each contour back in their order
+	for (int i = 0; i < Size(); ++i) {
+		reverse(_X.begin() + _Offsets[i], _X.begin() + _Offsets[i + 1]);
+		reverse(_Y.begin() + _Offsets[i], _Y.begin() + _Offsets[i + 1]);
+	}
+}
+
+void ContourSet::Get(const int i, vector<Point> &contour) const
+{
+	const int Nb_points = Count(i);
+	const int *X = this->X(i), *Y = this->Y(i);
+	contour.resize(Nb_points);
+	for (int k = 0; k < Nb_points; ++k) {
+		contour[k] = Point(X[k], Y[k]);
+	}
+}
+
+double ContourSet::Perimeter(const int i) const
+{
+	const int Nb_points = Count(i);
+	if (Nb_points < 2) return 0.0;
+	const int *X = this->X(i), *Y = this->Y(i);
+	//Closing side then the others (no dependency between iterations, the loop can be vectorised)
+	double Perimeter = sqrt(double((X[0] - X[Nb_points - 1]) * (X[0] - X[Nb_points - 1]) +
+								   (Y[0] - Y[Nb_points - 1]) * (Y[0] - Y[Nb_points - 1])));
+	for (int k = 1; k < Nb_points; ++k) {
+		const double Dx = X[k] - X[k - 1], Dy = Y[k] - Y[k - 1];
+		Perimeter += sqrt(Dx * Dx + Dy * Dy);
+	}
+	return Perimeter;
+}
+
+double ContourSet::Area(const int i) const
+{
+	const int Nb_points = Count(i);
+	if (Nb_points < 3) return 0.0;
+	const int *X = this->X(i), *Y = this->Y(i);
+	//Shoelace formula
+	double Area = double(X[Nb_points - 1]) * Y[0] - double(Y[Nb_points - 1]) * X[0];
+	for (int k = 1; k < Nb_points; ++k) {
+		Area += double(X[k - 1]) * Y[k] - double(Y[k - 1]) * X[k];
+	}
+	return fabs(Area) * 0.5;
+}
+
+Point ContourSet::Center(const int i) const
+{
+	const int Nb_points = Count(i);
+	if (Nb_points == 0) return Point(0, 0);
+	const int *X = this->X(i), *Y = this->Y(i);
+	int Sum_x = 0, Sum_y = 0;
+	for (int k = 0; k < Nb_points; ++k) {
+		Sum_x += X[k];
+		Sum_y += Y[k];
+	}
+	return Point(Sum_x / Nb_points, Sum_y / Nb_points);
+}
+
+Rect ContourSet::Box(const int i) const
+{
+	const int Nb_points = Count(i);
+	if (Nb_points == 0) return Rect();
+	const int *X = this->X(i), *Y = this->Y(i);
+	int X_min = X[0], X_max = X[0], Y_min = Y[0], Y_max = Y[0];
+	for (int k = 1; k < Nb_points; ++k) {
+		X_min = MIN(X_min, X[k]);
+		X_max = MAX(X_max, X[k]);
+		Y_min = MIN(Y_min, Y[k]);
+		Y_max = MAX(Y_max, Y[k]);
+	}
+	return Rect(X_min, Y_min, X_max - X_min + 1, Y_max - Y_min + 1);
+}
+//*****************************
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+struct CvSeq;
+
+//********************************
+//********* Contour Set **********
+//********************************
+/// <summary>
+/// Arena of contours in structure of arrays: all the x one after the other, all the y, and where each contour starts.
+/// Adding a contour doesn't allocate once the buffers are warm (Clear keeps them),
+/// the stages work on lists of contour indexes instead of copying the points.
+/// </summary>
+class ContourSet
+{
+public:
+	std::vector<int> _X, _Y;		// Coordinates of all the contours
+	std::vector<int> _Offsets;		// Contour i is [_Offsets[i], _Offsets[i + 1])
+
+	ContourSet();
+
+	/// <summary>Remove all the contours (the buffers are kept).</summary>
+	void Clear();
+
+	/// <summary>Number of contours.</summary>
+	int Size() const { return int(_Offsets.size()) - 1; }
+
+	/// <summary>Number of points of the contour i.</summary>
+	int Count(const int i) const { return _Offsets[i + 1] - _Offsets[i]; }
+
+	const int *X(const int i) const { return _X.data() + _Offsets[i]; }
+	const int *Y(const int i) const { return _Y.data() + _Offsets[i]; }
+	cv::Point At(const int i, const int k) const { return cv::Point(_X[_Offsets[i] + k], _Y[_Offsets[i] + k]); }
+
+	/// <summary>Append a contour of the contour tracer.</summary>
+	void Add(const CvSeq *seq);
+
+	/// <summary>Append a contour.</summary>
+	void Add(const cv::Point *points, int count);
+	void Add(const std::vector<cv::Point> &contour) { Add(contour.data(), int(contour.size())); }
+
+	/// <summary>Remove the last contour (its space is reused by the next one).</summary>
+	void RemoveLast();
+
+	/// <summary>Append a point to the contour being built (after the last one).</summary>
+	void Push(const int x, const int y)
+	{
+		_X.push_back(x);
+		_Y.push_back(y);
+	}
+
+	/// <summary>End the contour being built with the points pushed since the last one.</summary>
+	void Close() { _Offsets.push_back(int(_X.size())); }
+
+	/// <summary>Reverse the order of the contours (the points of each contour keep their order).</summary>
+	void Reverse();
+
+	/// <summary>Copy of the contour i (for the OpenCV functions).</summary>
+	void Get(int i, std::vector<cv::Point> &contour) const;
+
+	/// <summary>Perimeter of the closed contour i.</summary>
+	double Perimeter(int i) const;
+
+	/// <summary>Area of the contour i.</summary>
+	double Area(int i) const;
+
+	/// <summary>Center (mean of the points) of the contour i.</summary>
+	cv::Point Center(int i) const;
+
+	/// <summary>Bounding box of the contour i.</summary>
+	cv::Rect Box(int i) const;
+
+private:
+	/// <summary>Grow the coordinates buffers for count more points.</summary>
+	/// <returns>Index of the first new point.</returns>
+	int Grow(int count);
+};
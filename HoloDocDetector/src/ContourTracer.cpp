@@ -0,0 +1,194 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "DocDetector.hpp"
+#include "ContourTracer.hpp"
+#include "ThreadPool.hpp"
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc/types_c.h>
+#include <climits>
+
+using namespace std;
+using namespace cv;
+
+//**********************************
+//********** DECLARATIONS **********
+//**********************************
+// Marks of the border following (like cvFindContours with CV_RETR_TREE, the depth instead of the contour number):
+// 0 background, 1 not visited, depth + 1 once visited, with RIGHT when the background on the right of the pixel has been seen
+const schar RIGHT = -128;
+const int DEPTH_MAX = 126;
+
+/// <summary>Mark of the pixels of a border.</summary>
+static inline schar Mark(const int depth) { return schar(MIN(depth, DEPTH_MAX) + 1); }
+
+/// <summary>Depth of the border which marked a pixel.</summary>
+static inline int MarkDepth(const schar mark) { return (mark & 0x7f) - 1; }
+
+// Chain codes: 0 right, then counterclockwise (y down)
+const int CODE_DX[8] = {1, 1, 0, -1, -1, -1, 0, 1},
+		  CODE_DY[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+/// <summary>
+/// 0 / 1 values of the rows [begin, end) (0 on the border of the image)
+/// and x of the changes of value in [1, width - 1), where a contour can start.
+/// </summary>
+static void ScanBand(Mat &binary, int begin, int end, vector<int> &transitions, vector<int> &row_ends);
+
+/// <summary>Follow the border from a pixel (outer border: background on its left, hole: background on its right).</summary>
+static void FollowBorder(schar *start, int step, Point pt, bool hole, bool simple, schar mark, ContourSet &contours);
+
+//*********************************
+//********** DEFINITIONS **********
+//*********************************
+void ScanBand(Mat &binary, const int begin, const int end, vector<int> &transitions, vector<int> &row_ends)
+{
+	const int W = binary.cols, H = binary.rows;
+	transitions.clear();
+	row_ends.clear();
+	for (int y = begin; y < end; ++y) {
+		uchar *Row = binary.ptr<uchar>(y);
+		if (y == 0 || y == H - 1) {
+			memset(Row, 0, W);
+			row_ends.push_back(int(transitions.size()));
+			continue;
+		}
+		Row[0] = Row[W - 1] = 0;
+		int x = 1;
+#if CV_SIMD128
+		//16 pixels at once, the transitions are searched only where the row changes
+		const v_uint8x16 One = v_setall_u8(1), Zero = v_setall_u8(0);
+		for (; x <= W - 17; x += 16) {
+			const v_uint8x16 Values = ~(v_load(Row + x) == Zero) & One;
+			v_store(Row + x, Values);
+			if (!v_check_any(Values != v_load(Row + x - 1))) continue;
+			for (int k = x; k < x + 16; ++k) {
+				if (Row[k] != Row[k - 1]) transitions.push_back(k);
+			}
+		}
+#endif
+		for (; x < W - 1; ++x) {
+			Row[x] = Row[x] != 0 ? 1 : 0;
+			if (Row[x] != Row[x - 1]) transitions.push_back(x);
+		}
+		row_ends.push_back(int(transitions.size()));
+	}
+}
+
+void FollowBorder(schar *start, const int step, Point pt, const bool hole, const bool simple, const schar mark,
+				  ContourSet &contours)
+{
+	const int Deltas[16] = {1, 1 - step, -step, -1 - step, -1, step - 1, step, step + 1,
+							1, 1 - step, -step, -1 - step, -1, step - 1, step, step + 1};
+	schar *I0 = start, *I1, *I3, *I4;
+	int S, S_end, Prev_s;
+
+	//First neighbour clockwise from the background pixel
+	S_end = S = hole ? 0 : 4;
+	do {
+		S = (S - 1) & 7;
+		I1 = I0 + Deltas[S];
+	} while (*I1 == 0 && S != S_end);
+
+	//Single pixel
+	if (S == S_end) {
+		*I0 = mark | RIGHT;
+		contours.Push(pt.x, pt.y);
+		contours.Close();
+		return;
+	}
+
+	I3 = I0;
+	Prev_s = S ^ 4;
+	while (true) {
+		//Next neighbour counterclockwise
+		S_end = S;
+		do {
+			I4 = I3 + Deltas[++S];
+		} while (*I4 == 0);
+		S &= 7;
+
+		//Background on the right seen
+		if (unsigned(S - 1) < unsigned(S_end)) *I3 = mark | RIGHT;
+		else if (*I3 == 1) *I3 = mark;
+
+		//With CV_CHAIN_APPROX_SIMPLE only the points where the direction changes
+		if (!simple || S != Prev_s) {
+			contours.Push(pt.x, pt.y);
+			Prev_s = S;
+		}
+		pt.x += CODE_DX[S];
+		pt.y += CODE_DY[S];
+
+		if (I4 == I0 && I3 == I1) break;
+		I3 = I4;
+		S = (S + 4) & 7;
+	}
+	contours.Close();
+}
+
+int ContourTracer::Find(Mat &binary, ContourSet &contours, const int method, const int nb_threads, const Point offset,
+						const int max_depth)
+{
+	contours.Clear();
+	if (binary.empty()) return EMPTY_MAT;
+	if (binary.type() != CV_8UC1) return TYPE_MAT;
+	if (method != CV_CHAIN_APPROX_NONE && method != CV_CHAIN_APPROX_SIMPLE) return TYPE_MAT;
+
+	//Every pixel: by bands
+	const int Nb_bands = BandsCount(binary.rows, nb_threads);
+	_Transitions.resize(Nb_bands);
+	_Row_ends.resize(Nb_bands);
+	ParallelBands(binary.rows, Nb_bands, nb_threads, [&](const int band, const int begin, const int end) {
+		ScanBand(binary, begin, end, _Transitions[band], _Row_ends[band]);
+	});
+
+	//Transitions only, in raster order (the decisions depend on the marks of the previous contours)
+	const bool Simple = method == CV_CHAIN_APPROX_SIMPLE;
+	const int Max_depth = max_depth > 0 ? max_depth : INT_MAX;
+	int y = 0;
+	for (int band = 0; band < Nb_bands; ++band) {
+		const vector<int> &Transitions = _Transitions[band];
+		int k = 0;
+		for (const int Row_end : _Row_ends[band]) {
+			schar *Row = binary.ptr<schar>(y);
+			int Last_depth = 0;		// Depth of the last border met on the row (0: the frame)
+			for (; k < Row_end; ++k) {
+				const int x = Transitions[k];
+				const schar Prev = Row[x - 1], P = Row[x];
+				//Outer border on a pixel not visited yet, hole on the left of a background pixel
+				//(unless the border has already been followed with the background on this side)
+				const bool Outer = Prev == 0 && P == 1, Hole = P == 0 && Prev >= 1;
+				if (!Outer && !Hole) {
+					Last_depth = MarkDepth(P != 0 ? P : Prev);
+					continue;
+				}
+				if (Hole && Prev != 1) Last_depth = MarkDepth(Prev);
+
+				//Suzuki's rule: the outer borders have an odd depth (inside a hole or the frame), the holes an even one
+				const int Depth = Last_depth + ((Last_depth & 1) == int(Outer) ? 0 : 1);
+				if (Depth <= Max_depth) {
+					if (Outer) {
+						FollowBorder(Row + x, int(binary.step), Point(x, y) + offset, false, Simple, Mark(Depth), contours);
+					}
+					else {
+						FollowBorder(Row + x - 1, int(binary.step), Point(x - 1, y) + offset, true, Simple, Mark(Depth),
+									 contours);
+					}
+				}
+				//Deeper borders aren't followed: their pixels stay not visited, so the next rows
+				//meet them again below the same border and skip them (and all they contain) the same way
+				Last_depth = Depth;
+			}
+			y++;
+		}
+	}
+
+	//cvFindContours lists the last contour found first
+	contours.Reverse();
+	return NO_ERRORS;
+}
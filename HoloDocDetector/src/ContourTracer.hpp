@@ -0,0 +1,35 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include "ContourSet.hpp"
+#include <vector>
+
+//*********************************
+//******** Contour Tracer *********
+//*********************************
+/// <summary>
+/// Contours of a binary image: same contours, same points and same order as cvFindContours with CV_RETR_LIST,
+/// or only the contours down to a nesting depth (the contours deeper are neither followed nor listed).
+/// The pass on every pixel (thresholding and search of the transitions of each row) is spread on horizontal bands,
+/// then the borders are followed in raster order from these transitions only:
+/// a contour crossing several bands is followed once, and its marks stop the next transitions on it like in the serial scan.
+/// The buffers are kept from one frame to the next.
+/// </summary>
+class ContourTracer
+{
+public:
+	/// <summary>Find the contours.</summary>
+	/// <param name="binary">8-bit single-channel image, modified like with cvFindContours (border set to 0, 0 / 1 values and marks).</param>
+	/// <param name="contours">The contours (cleared first).</param>
+	/// <param name="method">CV_CHAIN_APPROX_NONE or CV_CHAIN_APPROX_SIMPLE.</param>
+	/// <param name="nb_threads">Number of threads of the pass on the pixels (0: one by core).</param>
+	/// <param name="offset">Offset added to every point.</param>
+	/// <param name="max_depth">Deepest contour kept: 1 the outer borders, 2 their holes, 3 the outer borders in these holes... (0: all).</param>
+	/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+	int Find(cv::Mat &binary, ContourSet &contours, int method, int nb_threads = 1, cv::Point offset = cv::Point(),
+			 int max_depth = 0);
+
+private:
+	std::vector<std::vector<int>> _Transitions;	// By band: x of the transitions of its rows
+	std::vector<std::vector<int>> _Row_ends;	// By band: end of each row in _Transitions
+};
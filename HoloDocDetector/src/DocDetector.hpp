@@ -1,6 +1,10 @@
 #pragma once
 
 #include <opencv2/core.hpp>
+#include "ColorTable.hpp"
+#include "ContourSet.hpp"
+#include "ContourTracer.hpp"
+#include "Rectifier.hpp"
 
 #define DLL_EXPORT extern "C" int __declspec(dllexport) __stdcall
 
@@ -11,6 +15,15 @@ const enum ERROR_CODE
 	TYPE_MAT,
 	NO_DOCS,
 	INVALID_DOC,
+	INVALID_SESSION,
+	NO_RESULT,
+	INVALID_ARGUMENT,
+};
+
+enum EDGE_FILTER
+{
+	EDGE_BLUR = 0,	// 3x3 box blur
+	EDGE_GUIDED,	// Edge-preserving guided filter (<see cref = "GuidedFilter"/>)
 };
 
 //********************************
@@ -23,6 +36,93 @@ struct Color32
 	byte r, g, b, a;
 };
 
+/// <summary>
+/// Detection parameters (plain struct so it can be marshalled from Unity).
+/// </summary>
+struct DetectorParams
+{
+	Color32 background;		// Background (desk) color
+	int colorRange;			// Tolerance around the background color
+	double ratioLengthMin,	// Minimum perimeter of a document (ratio of the image perimeter)
+		   ratioLengthMax,	// Maximum perimeter of a document (ratio of the image perimeter)
+		   ratioSide;		// Tolerance between the squared length of two opposite sides
+	int pyramidLevel;		// Detection on a 1/2^level image then corners refinement (0: full resolution, up to 3)
+	int trackingPeriod;		// Full detection at least every trackingPeriod frames with TrackDocs (0: always)
+	int nbThreads;			// Threads of the image processing stages (0: one by core)
+	int contourDepth;		// Deepest traced contour: 1 the outer borders of the background, 2 the documents in it... (0: all)
+	int rectifiedSide;		// Longest side of an extracted document at most (0: its length in the image)
+	int rectifiedFixed;		// 1: every extracted document is scaled to rectifiedSide (canonical size)
+};
+
+//********************************
+//*********** Session ************
+//********************************
+/// <summary>
+/// Document candidate, everything the filters need is computed once.
+/// </summary>
+struct ContourCandidate
+{
+	int Id;					// Index of the quad in _Contours (-1 once rejected)
+	double Perimeter, Area;	// Of the quad
+	cv::Point Quad[4];
+	cv::Point Center;
+	cv::Rect Box;
+};
+
+/// <summary>Buffers of the quad fit (<see cref = "HullQuad"/>), kept from one contour to the next.</summary>
+struct HullBuffers
+{
+	std::vector<cv::Point> Rows;		// Leftmost (x) and rightmost (y) point of each row
+	std::vector<cv::Point> Left, Right;	// Extremes of Rows that can be hull vertices, by row
+	std::vector<cv::Point> Chain;		// Monotone chain
+	std::vector<cv::Point2d> Poly;		// Hull vertices, moved by the collapses
+	std::vector<int> Next, Prev;		// Polygon left by the collapses, linked over the hull vertices
+	std::vector<cv::Point2d> Corners;	// Corner made by the collapse of each edge [i, Next[i]]
+	std::vector<double> Costs;			// Area added by the collapse of each edge (-1: impossible)
+};
+
+/// <summary>
+/// Detection session for one camera resolution.
+/// Owns every intermediate buffer of the detection pipeline and reuses them from frame to frame,
+/// so the steady state (same resolution, same parameters) doesn't allocate anything.
+/// </summary>
+class DetectorSession
+{
+public:
+	DetectorParams _Params;
+	cv::Size _Size;
+	int _Scale;				// 2^pyramidLevel
+	cv::Size _Work_size;	// Resolution of the detection (_Size / _Scale)
+	cv::Scalar _Lower, _Higher;		// Background color range
+	ColorTable _Table;		// Background colors when they don't fit in one range
+	bool _Use_table;
+	double _Length_min, _Length_max;	// Document perimeter range
+
+	cv::Mat _Binary;		// Binary image (_Work_size) with a one pixel black border (the contour tracer needs it)
+	cv::Mat _Binary_roi;	// View on _Binary without the border
+	ContourTracer _Tracer;	// Contour tracer, its buffers are kept from frame to frame
+	ContourSet _Raw;		// Traced contours of the frame (one arena instead of a vector by contour)
+	HullBuffers _Hull;		// Quad fit of the contours
+	Rectifier _Rectifier;	// Extraction of a document, its remap tables are kept while the document doesn't move
+	std::vector<std::vector<cv::Point>> _Contours;	// Only the _Nb_contours first ones are valid
+	int _Nb_contours;
+	std::vector<ContourCandidate> _Candidates;	// Documents of the last frame (sorted by area)
+	std::vector<int> _Index;	// Candidates sorted by the x of their center
+	int _Tracked_frames;	// Frames tracked since the last full detection (TrackDocs)
+	std::vector<cv::Vec8i> _Docs;
+
+	DetectorSession(uint width, uint height, const DetectorParams &params);
+	DetectorSession(const DetectorSession &) = delete;
+	DetectorSession &operator=(const DetectorSession &) = delete;
+	virtual ~DetectorSession();
+
+	/// <summary>Change the detection parameters (no reallocation unless the pyramid level changes).</summary>
+	void SetParams(const DetectorParams &params);
+
+	/// <summary>(Re)allocate the buffers for a new resolution.</summary>
+	void Resize(uint width, uint height);
+};
+
 //********************************
 //********** Unity Link **********
 //********************************
@@ -47,6 +147,64 @@ DLL_EXPORT DocsDetection(Color32 *image, uint width, uint height,
 
 DLL_EXPORT DocExtraction(Color32 *image, uint width, uint height,
 						 Color32 background, int *outDocPoints);
+
+/// <summary>Fill the parameters with the default values.</summary>
+/// <return>INVALID_ARGUMENT if params is null.</return>
+/// <param name="params">The parameters.</param>
+DLL_EXPORT GetDefaultDetectorParams(DetectorParams *params);
+
+/// <summary>
+/// Create a detection session, its buffers are allocated for the given resolution.
+/// </summary>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="params">Detection parameters.</param>
+/// <param name="outSession">The created session (to release with DestroyDetectorSession).</param>
+DLL_EXPORT CreateDetectorSession(uint width, uint height, DetectorParams params, DetectorSession **outSession);
+
+DLL_EXPORT DestroyDetectorSession(DetectorSession *session);
+
+/// <summary>
+/// Documents detector using the session buffers (no allocation once the session is warm).
+/// </summary>
+/// <param name="session">Detection session.</param>
+/// <param name="image">Unity image.</param>
+/// <param name="out">Documents definition for Unity.</param>
+DLL_EXPORT SessionDocsDetection(DetectorSession *session, Color32 *image, uint width, uint height,
+								uint *outDocsCount, int *outDocsPoints);
+
+DLL_EXPORT SessionDocExtraction(DetectorSession *session, Color32 *image, uint width, uint height,
+								int *outDocPoints);
+
+/// <summary>
+/// Documents tracker: the documents of the previous frame are followed with a local search of their corners,
+/// the full detection only runs when a document is lost or every trackingPeriod frames.
+/// </summary>
+/// <param name="session">Detection session (keeps the documents from one frame to the next).</param>
+/// <param name="image">Unity image.</param>
+/// <param name="out">Documents definition for Unity.</param>
+DLL_EXPORT TrackDocs(DetectorSession *session, Color32 *image, uint width, uint height,
+					 uint *outDocsCount, int *outDocsPoints);
+
+/// <summary>
+/// Several background colors (two-tone or patterned desk), each one with the colorRange of the parameters.
+/// </summary>
+/// <param name="session">Detection session.</param>
+/// <param name="colors">The background colors (none: back to the background of the parameters).</param>
+/// <param name="nbColors">Number of colors.</param>
+DLL_EXPORT SessionBackgroundColors(DetectorSession *session, Color32 *colors, uint nbColors);
+
+/// <summary>
+/// Background learned from a region of a frame (only background in it), with a tolerance of colorRange.
+/// </summary>
+/// <param name="session">Detection session.</param>
+/// <param name="image">Unity image.</param>
+/// <param name="x">Left of the region.</param>
+/// <param name="y">Top of the region.</param>
+/// <param name="regionWidth">Width of the region.</param>
+/// <param name="regionHeight">Height of the region.</param>
+DLL_EXPORT SessionLearnBackground(DetectorSession *session, Color32 *image, uint width, uint height,
+								  int x, int y, int regionWidth, int regionHeight);
 //*****************************
 //********** Methods **********
 //*****************************
@@ -59,6 +217,57 @@ int DocsDetection(const cv::Mat &src, const cv::Scalar &background, std::vector<
 
 int DocExtraction(const cv::Mat &src, const cv::Scalar &background, std::vector<cv::Point> &contour, cv::Mat &dst);
 
+/// <summary>
+/// Documents detection on many images, spread over the persistent workers of ParallelFor (one session by worker).
+/// Each image is detected on one worker: the image processing stages don't split it in bands.
+/// </summary>
+/// <param name="srcs">tri-channel 8-bit input images.</param>
+/// <param name="background">The background.</param>
+/// <param name="contours">The contours of each image (empty if no document is found or if its detection fails).</param>
+/// <param name="errors">The error code of each image.</param>
+/// <param name="nb_threads">Number of threads (0: one by core).</param>
+/// <return>The error code of the first image that fails, NO_ERRORS otherwise.</return>
+int DocsDetectionBatch(const std::vector<cv::Mat> &srcs, const cv::Scalar &background,
+					   std::vector<std::vector<std::vector<cv::Point>>> &contours, std::vector<int> &errors,
+					   int nb_threads = 0);
+
+/// <summary>Documents detection with the session buffers.</summary>
+/// <param name="session">The session (resized if the source resolution changed).</param>
+/// <param name="src">tri-channel 8-bit input image.</param>
+/// <param name="contours">The contours.</param>
+int DocsDetection(DetectorSession &session, const cv::Mat &src, std::vector<std::vector<cv::Point>> &contours);
+
+/// <summary>Documents detection on a Unity image with the session buffers.</summary>
+/// <remarks>Documents are kept in session._Contours (the _Nb_contours first ones).</remarks>
+int DocsDetection(DetectorSession &session, Color32 *image, uint width, uint height);
+
+int DocExtraction(DetectorSession &session, const cv::Mat &src, std::vector<cv::Point> &contour, cv::Mat &dst);
+
+/// <summary>Documents tracking on a Unity image (see the TrackDocs export).</summary>
+/// <remarks>Documents are kept in session._Contours (the _Nb_contours first ones).</remarks>
+int TrackDocs(DetectorSession &session, Color32 *image, uint width, uint height);
+
+/// <summary>Background made of several colors (see the SessionBackgroundColors export).</summary>
+/// <param name="colors">The background colors (BGR), none to use the background of the parameters.</param>
+int SetBackgroundColors(DetectorSession &session, const std::vector<cv::Scalar> &colors);
+
+/// <summary>Background learned from a region of an image (see the SessionLearnBackground export).</summary>
+/// <param name="region">tri-channel 8-bit image (BGR) of the background only.</param>
+int LearnBackground(DetectorSession &session, const cv::Mat &region);
+
+/// <summary>Reject the candidates nested in a larger one, and the duplicates (their Id is set to -1).</summary>
+/// <param name="candidates">The candidates, sorted by decreasing area by the function.</param>
+/// <param name="index">Buffer of the candidates sorted by the x of their center.</param>
+/// <param name="length_min">Minimum perimeter of a quad that rejects the ones inside it.</param>
+/// <param name="length_max">Maximum perimeter of a quad that rejects the ones inside it.</param>
+void ExcludeNested(std::vector<ContourCandidate> &candidates, std::vector<int> &index, double length_min, double length_max);
+
+/// <summary>Verify if the point is on the Quad.</summary>
+/// <param name="quad">The quad.</param>
+/// <param name="point">The point.</param>
+/// <returns><c>True</c> if the poitn is in the quad, <c>False</c> if not</returns>
+bool inQuad(const cv::Point quad[4], const cv::Point &point);
+
 int FeaturesExtraction(const cv::Mat &src/*, features*/);
 
 int CompareDocs(const cv::Mat &im1, const cv::Mat &im2, double &similarity);
@@ -75,5 +284,19 @@ int CompareFeatures(/*features1, features2,*/double &similarity);
 /// <param name="min_tresh">first threshold for the hysteresis procedure.</param>
 /// <param name="max_tresh">second threshold for the hysteresis procedure.</param>
 /// <param name="aperture">aperture size for the Sobel operator.</param>
-int BinaryEdgeDetector(const cv::Mat &src, cv::Mat &dst,
-					   int min_tresh = 50, int max_tresh = 205, int aperture = 3);
+/// <param name="filter">smoothing before the hysteresis (<see cref = "EDGE_FILTER"/>).</param>
+int BinaryEdgeDetector(const cv::Mat &src, cv::Mat &dst, int min_tresh = 50, int max_tresh = 205, int aperture = 3,
+					   int filter = EDGE_BLUR);
+
+/// <summary>
+/// Edge-preserving smoothing (guided filter with the image as guide), a fast replacement of bilateralFilter.
+/// Only box filters: the cost by pixel doesn't depend on the radius.
+/// The linear coefficients are computed on a 1/subsample image then upsampled.
+/// </summary>
+/// <param name="src">single-channel 8-bit input image.</param>
+/// <param name="dst">single-channel 8-bit smoothed image.</param>
+/// <param name="radius">radius of the window (full resolution pixels).</param>
+/// <param name="eps">regularisation (squared gray levels), the variances far under eps are smoothed.</param>
+/// <param name="subsample">subsampling of the coefficients (1: exact guided filter).</param>
+/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+int GuidedFilter(const cv::Mat &src, cv::Mat &dst, int radius = 8, double eps = 400, int subsample = 2);
@@ -0,0 +1,1082 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "Kernels.hpp"
+#include "ThreadPool.hpp"
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgproc/types_c.h>
+#include <cfloat>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+using namespace cv;
+
+//**********************************
+//********** DECLARATIONS **********
+//**********************************
+const int MAX_SCALE = 8,					// 1/8 of the resolution at most
+		  REFINE_RADIUS = 2,				// Refinement window radius (in coarse pixels)
+		  MAX_RADIUS = REFINE_RADIUS * MAX_SCALE,	// Search window radius (in pixels)
+		  SEARCH_SIZE = 2 * MAX_RADIUS + 3;	// Search window side with a one pixel margin
+
+const int BORDER_SAMPLES = 16,				// Samples by side for the border score
+		  BORDER_OFFSET = 3;				// Distance between the samples and the side
+
+const int NARROW_EXTENT = 1 << 14,			// Contour extent with 16 bits differences and 32 bits sums of two products
+		  CORNERS_CHUNK = 64;				// Points by chunk of the corners scans (the maximum is searched back in one chunk)
+
+const int GRAY_SHIFT = 14,					// Fixed point gray conversion of cvtColor
+		  GRAY_R = 4899, GRAY_G = 9617, GRAY_B = 1868,
+		  CANNY_SHIFT = 15,					// Fixed point gradient directions of Canny
+		  CANNY_TG22 = int(0.4142135623730950488016887242097 * (1 << CANNY_SHIFT) + 0.5);
+
+/// <summary>Background bounds in the channel order of the buffer.</summary>
+/// <param name="lower">The lower background color (BGR like OpenCV).</param>
+/// <param name="higher">The higher background color (BGR like OpenCV).</param>
+/// <param name="rgb"><c>True</c> for a Unity buffer (RGBA), <c>False</c> for an OpenCV one (BGR).</param>
+/// <param name="lo">The lower bound of the 3 first channels.</param>
+/// <param name="hi">The higher bound of the 3 first channels.</param>
+static void GetBounds(const Scalar &lower, const Scalar &higher, bool rgb, uchar lo[3], uchar hi[3]);
+
+/// <summary>Verify if a pixel is in the background range.</summary>
+static bool IsBackground(const uchar *p, const uchar lo[3], const uchar hi[3]);
+
+/// <summary>Background test of a pixel with a color box (the 3 first channels in the order of the buffer).</summary>
+struct BoxBackground
+{
+	uchar Lo[3], Hi[3];
+
+	BoxBackground(const Scalar &lower, const Scalar &higher, const bool rgb) { GetBounds(lower, higher, rgb, Lo, Hi); }
+	bool operator()(const uchar *p) const { return IsBackground(p, Lo, Hi); }
+};
+
+/// <summary>Background test of a pixel with a color table.</summary>
+template <bool RGB>
+struct TableBackground
+{
+	const ColorTable &Table;
+
+	explicit TableBackground(const ColorTable &table) : Table(table) {}
+	bool operator()(const uchar *p) const { return RGB ? Table.Contains(p[0], p[1], p[2]) : Table.Contains(p[2], p[1], p[0]); }
+};
+
+/// <summary>Background mask of a CN-channel buffer, one pixel every scale pixels.</summary>
+template <int CN>
+static void MaskKernel(const uchar *data, size_t step, int width, int height, int scale,
+					   const uchar lo[3], const uchar hi[3], Mat &dst, int nb_threads);
+
+/// <summary>Background mask of a CN-channel buffer with a color table, one pixel every scale pixels.</summary>
+template <int CN, bool RGB>
+static void TableMaskKernel(const uchar *data, size_t step, int width, int height, int scale,
+							const ColorTable &table, Mat &dst, int nb_threads);
+
+/// <summary>Move the corners of a quad to the background border in a (2 * radius + 1) window.</summary>
+template <int CN, class Background>
+static void SearchKernel(const uchar *data, size_t step, int width, int height, int radius,
+						 const Background &is_background, vector<Point> &quad);
+
+/// <summary>Border contrast of a quad on a Unity image (see BorderScore).</summary>
+template <class Background>
+static double BorderKernel(const Color32 *image, uint width, uint height, const Background &is_background,
+						   const vector<Point> &quad);
+
+/// <summary>Index of the first point with the biggest squared distance to from (0 if they are all on it).</summary>
+/// <remarks>NARROW: the differences of coordinates fit on 15 bits (16 bits products).</remarks>
+template <bool NARROW>
+static int FarthestPoint(const int *x, const int *y, int nb_points, const Point &from);
+
+/// <summary>Index of the first point with the biggest cross product (ids[0]) and the smallest one (ids[1]) on the line ab.</summary>
+template <bool NARROW>
+static void FarthestFromLine(const int *x, const int *y, int nb_points, const Point &a, const Point &b, int ids[2]);
+
+/// <summary>
+/// Convex hull in hull.Poly (positive area): the leftmost and rightmost points of each row are already sorted on (y, x),
+/// the monotone chain runs on them without sorting (a contour can come back on itself, no simple polyline algorithm).
+/// An extreme that doesn't stick out of the extremes of the rows above and below can't be a vertex, it is left out first.
+/// </summary>
+static void RowsHull(const int *x, const int *y, int nb_points, HullBuffers &hull);
+
+/// <summary>Twice the signed area of the triangle (o, a, b), exact on integers.</summary>
+static inline int64_t Cross(const Point &o, const Point &a, const Point &b);
+
+/// <summary>Area added by the collapse of the edge [i, Next[i]] of the polygon (its neighbour edges extended), -1 if they diverge.</summary>
+static double CollapseCost(const HullBuffers &hull, int i, Point2d &corner);
+
+/// <summary>
+/// Runs of edge candidates of one frame (row, [x0, x1]) with the union-find of the hysteresis:
+/// a run is an edge if its component has a pixel over the high threshold.
+/// </summary>
+struct EdgeRuns
+{
+	vector<int> Row, X0, X1, Parent;
+	vector<uchar> Strong;
+
+	int Size() const { return int(Row.size()); }
+	void Add(int row, int x0, int x1, bool strong);
+	int Find(int i);
+	void Union(int a, int b);
+
+	/// <summary>Append the runs (and their unions) of the next band.</summary>
+	void Append(const EdgeRuns &runs);
+
+	/// <summary>Union of the runs [begin, end) of a row with the 8-connected runs [prev_begin, begin) of the row above.</summary>
+	void Connect(int prev_begin, int begin, int end);
+};
+
+/// <summary>Gray row of a CN-channel buffer (same rounding as cvtColor).</summary>
+template <int CN, bool RGB>
+static void GrayRow(const uchar *src, int width, uchar *dst);
+
+/// <summary>3x3 box blur of a row from the 3 gray rows around it (reflected border like blur).</summary>
+static void BlurRow(const uchar *up, const uchar *row, const uchar *down, int width, ushort *sums, uchar *dst);
+
+/// <summary>3x3 Sobel gradients and L1 magnitude of a row from the 3 padded blurred rows around it.</summary>
+static void SobelRow(const uchar *up, const uchar *row, const uchar *down, int width, short *dx, short *dy, short *mag);
+
+/// <summary>Non-maximum suppression of a row (padded magnitudes), the candidates are appended as runs.</summary>
+static void SuppressionRow(const short *up, const short *mag, const short *down, const short *dx, const short *dy,
+						   int width, int row, int low, int high, EdgeRuns &runs);
+
+/// <summary>Edge runs of the rows [begin, end) of a CN-channel buffer (connected inside the band), dst rows set to 0.</summary>
+template <int CN, bool RGB>
+static void EdgeBand(const uchar *data, size_t step, int width, int height, int begin, int end, int low, int high,
+					 EdgeRuns &runs, Mat &dst);
+
+/// <summary>Canny edges of a CN-channel buffer in one sweep by band, the runs are stitched at the band limits (see EdgeMap).</summary>
+template <int CN, bool RGB>
+static void EdgeKernel(const uchar *data, size_t step, int width, int height, int low, int high, int nb_threads, Mat &dst);
+
+#if CV_SIMD128
+/// <summary>Squared distances of the points [i, i + 8) to from (lo: 4 first ones, hi: 4 last ones).</summary>
+template <bool NARROW>
+static void SquaredDist8(const int *x, const int *y, int i, const v_int32x4 &from_x, const v_int32x4 &from_y,
+						 v_int32x4 &lo, v_int32x4 &hi);
+
+/// <summary>Cross products (ab ^ ap) of the points [i, i + 8) (lo: 4 first ones, hi: 4 last ones).</summary>
+template <bool NARROW>
+static void Cross8(const int *x, const int *y, int i, const v_int32x4 &a_x, const v_int32x4 &a_y,
+				   const v_int32x4 &ab_x, const v_int32x4 &ab_y, const v_int16x8 &w, v_int32x4 &lo, v_int32x4 &hi);
+#endif
+
+//*********************************
+//********** DEFINITIONS **********
+//*********************************
+void GetBounds(const Scalar &lower, const Scalar &higher, const bool rgb, uchar lo[3], uchar hi[3])
+{
+	//Scalar are in BGR order, Color32 in RGBA
+	for (int c = 0; c < 3; ++c) {
+		const int Id = rgb ? 2 - c : c;
+		lo[c] = saturate_cast<uchar>(lower[Id]);
+		hi[c] = saturate_cast<uchar>(higher[Id]);
+	}
+}
+
+bool IsBackground(const uchar *p, const uchar lo[3], const uchar hi[3])
+{
+	return lo[0] <= p[0] && p[0] <= hi[0] &&
+		   lo[1] <= p[1] && p[1] <= hi[1] &&
+		   lo[2] <= p[2] && p[2] <= hi[2];
+}
+
+template <int CN>
+void MaskKernel(const uchar *data, const size_t step, const int width, const int height, const int scale,
+				const uchar lo[3], const uchar hi[3], Mat &dst, const int nb_threads)
+{
+	const int W = (width + scale - 1) / scale, H = (height + scale - 1) / scale;
+	dst.create(H, W, CV_8UC1);
+
+#if CV_SIMD128
+	const v_uint8x16 Lower_0 = v_setall_u8(lo[0]), Lower_1 = v_setall_u8(lo[1]), Lower_2 = v_setall_u8(lo[2]),
+					 Higher_0 = v_setall_u8(hi[0]), Higher_1 = v_setall_u8(hi[1]), Higher_2 = v_setall_u8(hi[2]);
+#endif
+
+	//Bands of rows on the workers
+	ParallelBands(H, BandsCount(H, nb_threads), nb_threads, [&](int, const int begin, const int end) {
+		for (int y = begin; y < end; ++y) {
+			const uchar *Src = data + size_t(y) * scale * step;
+			uchar *Dst = dst.ptr<uchar>(y);
+			int x = 0;
+#if CV_SIMD128
+			//16 pixels (64 bytes) per iteration, only on the full resolution Unity frame
+			if (CN == 4 && scale == 1) {
+				for (; x <= W - 16; x += 16) {
+					v_uint8x16 C0, C1, C2, C3;
+					v_load_deinterleave(Src + 4 * x, C0, C1, C2, C3);
+					const v_uint8x16 Mask = (C0 >= Lower_0) & (C0 <= Higher_0) &
+											(C1 >= Lower_1) & (C1 <= Higher_1) &
+											(C2 >= Lower_2) & (C2 <= Higher_2);
+					v_store(Dst + x, Mask);
+				}
+			}
+#endif
+			for (; x < W; ++x) {
+				Dst[x] = IsBackground(Src + size_t(x) * scale * CN, lo, hi) ? 255 : 0;
+			}
+		}
+	});
+}
+
+template <int CN, bool RGB>
+void TableMaskKernel(const uchar *data, const size_t step, const int width, const int height, const int scale,
+					 const ColorTable &table, Mat &dst, const int nb_threads)
+{
+	const int W = (width + scale - 1) / scale, H = (height + scale - 1) / scale;
+	dst.create(H, W, CV_8UC1);
+	const TableBackground<RGB> Is_background(table);
+
+	//One lookup by pixel (no gather in the universal intrinsics), bands of rows on the workers
+	ParallelBands(H, BandsCount(H, nb_threads), nb_threads, [&](int, const int begin, const int end) {
+		for (int y = begin; y < end; ++y) {
+			const uchar *Src = data + size_t(y) * scale * step;
+			uchar *Dst = dst.ptr<uchar>(y);
+			const size_t Pixel_step = size_t(scale) * CN;
+			for (int x = 0; x < W; ++x, Src += Pixel_step) {
+				Dst[x] = Is_background(Src) ? 255 : 0;
+			}
+		}
+	});
+}
+
+template <int CN, class Background>
+void SearchKernel(const uchar *data, const size_t step, const int width, const int height, const int radius,
+				  const Background &is_background, vector<Point> &quad)
+{
+	const int Size = 2 * radius + 3;
+	uchar Doc[SEARCH_SIZE * SEARCH_SIZE];	// 1 on a document pixel, the window has a one pixel margin
+	Point Res[4];
+
+	for (int k = 0; k < 4; ++k) {
+		const Point P = quad[k],
+					Prev = quad[(k + 3) % 4],
+					Next = quad[(k + 1) % 4];
+		Res[k] = P;
+
+		//Outward bisector of the corner, the corner is the border point that maximize the projection on it
+		const Point2d U = Point2d(P - Prev), V = Point2d(P - Next);
+		const double Norm_u = norm(U), Norm_v = norm(V);
+		if (Norm_u == 0 || Norm_v == 0) continue;
+		const Point2d B = U / Norm_u + V / Norm_v;
+
+		//Document mask on the window (outside of the image is not a document)
+		const int X0 = P.x - radius - 1, Y0 = P.y - radius - 1;
+		for (int y = 0; y < Size; ++y) {
+			const int Yi = Y0 + y;
+			for (int x = 0; x < Size; ++x) {
+				const int Xi = X0 + x;
+				const bool In_image = 0 <= Xi && Xi < width && 0 <= Yi && Yi < height;
+				Doc[y * Size + x] = In_image && !is_background(data + size_t(Yi) * step + size_t(Xi) * CN);
+			}
+		}
+
+		//Background pixels next to the document (what the contour tracer follows)
+		double Proj_max = -DBL_MAX;
+		for (int y = 1; y < Size - 1; ++y) {
+			const int Yi = Y0 + y;
+			if (Yi < 0 || Yi >= height) continue;
+			for (int x = 1; x < Size - 1; ++x) {
+				const int Xi = X0 + x, Id = y * Size + x;
+				if (Xi < 0 || Xi >= width || Doc[Id]) continue;
+				if (!(Doc[Id - 1] | Doc[Id + 1] | Doc[Id - Size] | Doc[Id + Size])) continue;
+				const double Proj = B.x * Xi + B.y * Yi;
+				if (Proj > Proj_max) {
+					Proj_max = Proj;
+					Res[k] = Point(Xi, Yi);
+				}
+			}
+		}
+	}
+	copy(Res, Res + 4, quad.begin());
+}
+
+int BackgroundMask(const Color32 *image, const uint width, const uint height,
+				   const Scalar &lower, const Scalar &higher, Mat &dst, const uint scale, const int nb_threads)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	if (scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	uchar Lower[3], Higher[3];
+	GetBounds(lower, higher, true, Lower, Higher);
+	MaskKernel<4>(reinterpret_cast<const uchar *>(image), size_t(width) * sizeof(Color32), int(width), int(height),
+				  int(scale), Lower, Higher, dst, nb_threads);
+	return NO_ERRORS;
+}
+
+int BackgroundMask(const Mat &src, const Scalar &lower, const Scalar &higher, Mat &dst, const uint scale,
+				   const int nb_threads)
+{
+	if (src.empty()) return EMPTY_MAT;
+	if (src.type() != CV_8UC3 || scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	uchar Lower[3], Higher[3];
+	GetBounds(lower, higher, false, Lower, Higher);
+	MaskKernel<3>(src.data, src.step, src.cols, src.rows, int(scale), Lower, Higher, dst, nb_threads);
+	return NO_ERRORS;
+}
+
+int BackgroundMask(const Color32 *image, const uint width, const uint height,
+				   const ColorTable &table, Mat &dst, const uint scale, const int nb_threads)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	if (scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	TableMaskKernel<4, true>(reinterpret_cast<const uchar *>(image), size_t(width) * sizeof(Color32), int(width),
+							 int(height), int(scale), table, dst, nb_threads);
+	return NO_ERRORS;
+}
+
+int BackgroundMask(const Mat &src, const ColorTable &table, Mat &dst, const uint scale, const int nb_threads)
+{
+	if (src.empty()) return EMPTY_MAT;
+	if (src.type() != CV_8UC3 || scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	TableMaskKernel<3, false>(src.data, src.step, src.cols, src.rows, int(scale), table, dst, nb_threads);
+	return NO_ERRORS;
+}
+
+int RefineCorners(const Color32 *image, const uint width, const uint height,
+				  const Scalar &lower, const Scalar &higher, const uint scale, vector<Point> &quad)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	if (quad.size() != 4) return INVALID_DOC;
+	if (scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	//A coarse pixel (x, y) is the full resolution pixel (x * scale, y * scale)
+	for (Point &P : quad) P *= int(scale);
+	SearchKernel<4>(reinterpret_cast<const uchar *>(image), size_t(width) * sizeof(Color32), int(width), int(height),
+					REFINE_RADIUS * int(scale), BoxBackground(lower, higher, true), quad);
+	return NO_ERRORS;
+}
+
+int RefineCorners(const Mat &src, const Scalar &lower, const Scalar &higher, const uint scale, vector<Point> &quad)
+{
+	if (src.empty()) return EMPTY_MAT;
+	if (src.type() != CV_8UC3 || scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	if (quad.size() != 4) return INVALID_DOC;
+	for (Point &P : quad) P *= int(scale);
+	SearchKernel<3>(src.data, src.step, src.cols, src.rows, REFINE_RADIUS * int(scale),
+					BoxBackground(lower, higher, false), quad);
+	return NO_ERRORS;
+}
+
+int RefineCorners(const Color32 *image, const uint width, const uint height,
+				  const ColorTable &table, const uint scale, vector<Point> &quad)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	if (quad.size() != 4) return INVALID_DOC;
+	if (scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	for (Point &P : quad) P *= int(scale);
+	SearchKernel<4>(reinterpret_cast<const uchar *>(image), size_t(width) * sizeof(Color32), int(width), int(height),
+					REFINE_RADIUS * int(scale), TableBackground<true>(table), quad);
+	return NO_ERRORS;
+}
+
+int RefineCorners(const Mat &src, const ColorTable &table, const uint scale, vector<Point> &quad)
+{
+	if (src.empty()) return EMPTY_MAT;
+	if (src.type() != CV_8UC3 || scale < 1 || scale > MAX_SCALE) return TYPE_MAT;
+	if (quad.size() != 4) return INVALID_DOC;
+	for (Point &P : quad) P *= int(scale);
+	SearchKernel<3>(src.data, src.step, src.cols, src.rows, REFINE_RADIUS * int(scale),
+					TableBackground<false>(table), quad);
+	return NO_ERRORS;
+}
+
+int SearchCorners(const Color32 *image, const uint width, const uint height,
+				  const Scalar &lower, const Scalar &higher, const uint radius, vector<Point> &quad)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	if (quad.size() != 4) return INVALID_DOC;
+	if (radius > MAX_RADIUS) return TYPE_MAT;
+	SearchKernel<4>(reinterpret_cast<const uchar *>(image), size_t(width) * sizeof(Color32), int(width), int(height),
+					int(radius), BoxBackground(lower, higher, true), quad);
+	return NO_ERRORS;
+}
+
+int SearchCorners(const Color32 *image, const uint width, const uint height,
+				  const ColorTable &table, const uint radius, vector<Point> &quad)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	if (quad.size() != 4) return INVALID_DOC;
+	if (radius > MAX_RADIUS) return TYPE_MAT;
+	SearchKernel<4>(reinterpret_cast<const uchar *>(image), size_t(width) * sizeof(Color32), int(width), int(height),
+					int(radius), TableBackground<true>(table), quad);
+	return NO_ERRORS;
+}
+
+template <class Background>
+double BorderKernel(const Color32 *image, const uint width, const uint height, const Background &is_background,
+					const vector<Point> &quad)
+{
+	if (image == nullptr || quad.size() != 4) return 0.0;
+
+	//Orientation of the quad, the inside is on the left of the sides if the area is positive
+	int Area = 0;
+	for (int k = 0; k < 4; ++k) {
+		const Point &A = quad[k], &B = quad[(k + 1) % 4];
+		Area += A.x * B.y - A.y * B.x;
+	}
+	if (Area == 0) return 0.0;
+	const double Sign = Area > 0 ? 1.0 : -1.0;
+
+	const uchar *Data = reinterpret_cast<const uchar *>(image);
+	int Nb_good = 0;
+	for (int k = 0; k < 4; ++k) {
+		const Point2d A = quad[k], D = Point2d(quad[(k + 1) % 4]) - A;
+		const double Length = norm(D);
+		if (Length == 0) return 0.0;
+		const Point2d Normal = Point2d(D.y, -D.x) * (Sign * BORDER_OFFSET / Length);	// Outward
+		for (int i = 0; i < BORDER_SAMPLES; ++i) {
+			const Point2d P = A + D * ((i + 0.5) / BORDER_SAMPLES);
+			const Point Out(cvRound(P.x + Normal.x), cvRound(P.y + Normal.y)),
+						In(cvRound(P.x - Normal.x), cvRound(P.y - Normal.y));
+			if (Out.x < 0 || Out.y < 0 || Out.x >= int(width) || Out.y >= int(height) ||
+				In.x < 0 || In.y < 0 || In.x >= int(width) || In.y >= int(height)) continue;
+			//Background outside, document inside
+			if (is_background(Data + 4 * (size_t(Out.y) * width + Out.x)) &&
+				!is_background(Data + 4 * (size_t(In.y) * width + In.x))) {
+				Nb_good++;
+			}
+		}
+	}
+	return double(Nb_good) / (4 * BORDER_SAMPLES);
+}
+
+double BorderScore(const Color32 *image, const uint width, const uint height,
+				   const Scalar &lower, const Scalar &higher, const vector<Point> &quad)
+{
+	return BorderKernel(image, width, height, BoxBackground(lower, higher, true), quad);
+}
+
+double BorderScore(const Color32 *image, const uint width, const uint height,
+				   const ColorTable &table, const vector<Point> &quad)
+{
+	return BorderKernel(image, width, height, TableBackground<true>(table), quad);
+}
+
+//***** Corners *****
+// One pass by scan on the maximum only (no index to carry in the lanes), with the first chunk that reaches it:
+// the first point with the maximum is then searched in this chunk only.
+#if CV_SIMD128
+template <bool NARROW>
+void SquaredDist8(const int *x, const int *y, const int i, const v_int32x4 &from_x, const v_int32x4 &from_y,
+				  v_int32x4 &lo, v_int32x4 &hi)
+{
+	const v_int32x4 Dx_lo = v_load(x + i) - from_x, Dx_hi = v_load(x + i + 4) - from_x,
+					Dy_lo = v_load(y + i) - from_y, Dy_hi = v_load(y + i + 4) - from_y;
+	if (NARROW) {
+		//(dx, dy) pairs on 16 bits: dx * dx + dy * dy is one multiply-add
+		v_int16x8 Pairs_lo, Pairs_hi;
+		v_zip(v_pack(Dx_lo, Dx_hi), v_pack(Dy_lo, Dy_hi), Pairs_lo, Pairs_hi);
+		lo = v_dotprod(Pairs_lo, Pairs_lo);
+		hi = v_dotprod(Pairs_hi, Pairs_hi);
+	}
+	else {
+		lo = Dx_lo * Dx_lo + Dy_lo * Dy_lo;
+		hi = Dx_hi * Dx_hi + Dy_hi * Dy_hi;
+	}
+}
+
+template <bool NARROW>
+void Cross8(const int *x, const int *y, const int i, const v_int32x4 &a_x, const v_int32x4 &a_y,
+			const v_int32x4 &ab_x, const v_int32x4 &ab_y, const v_int16x8 &w, v_int32x4 &lo, v_int32x4 &hi)
+{
+	const v_int32x4 Dx_lo = v_load(x + i) - a_x, Dx_hi = v_load(x + i + 4) - a_x,
+					Dy_lo = v_load(y + i) - a_y, Dy_hi = v_load(y + i + 4) - a_y;
+	if (NARROW) {
+		//(dy, dx) pairs on 16 bits: ab.x * dy - ab.y * dx is one multiply-add with w = (ab.x, -ab.y)
+		v_int16x8 Pairs_lo, Pairs_hi;
+		v_zip(v_pack(Dy_lo, Dy_hi), v_pack(Dx_lo, Dx_hi), Pairs_lo, Pairs_hi);
+		lo = v_dotprod(Pairs_lo, w);
+		hi = v_dotprod(Pairs_hi, w);
+	}
+	else {
+		lo = ab_x * Dy_lo - ab_y * Dx_lo;
+		hi = ab_x * Dy_hi - ab_y * Dx_hi;
+	}
+}
+#endif
+
+template <bool NARROW>
+int FarthestPoint(const int *x, const int *y, const int nb_points, const Point &from)
+{
+	int Dist_max = 0, Chunk = 0, i = 0;
+#if CV_SIMD128
+	//Maximum of each chunk, the first chunk with the maximum is kept
+	const v_int32x4 From_x = v_setall_s32(from.x), From_y = v_setall_s32(from.y);
+	for (; i <= nb_points - CORNERS_CHUNK; i += CORNERS_CHUNK) {
+		v_int32x4 Max = v_setall_s32(0);
+		for (int k = i; k < i + CORNERS_CHUNK; k += 8) {
+			v_int32x4 Lo, Hi;
+			SquaredDist8<NARROW>(x, y, k, From_x, From_y, Lo, Hi);
+			Max = v_max(Max, v_max(Lo, Hi));
+		}
+		const int Chunk_max = v_reduce_max(Max);
+		if (Chunk_max > Dist_max) {
+			Dist_max = Chunk_max;
+			Chunk = i;
+		}
+	}
+#endif
+	int Id = -1;
+	for (; i < nb_points; ++i) {
+		const int Dx = x[i] - from.x, Dy = y[i] - from.y;
+		const int Dist = Dx * Dx + Dy * Dy;
+		if (Dist > Dist_max) {
+			Dist_max = Dist;
+			Id = i;
+		}
+	}
+	if (Id >= 0 || Dist_max == 0) return MAX(Id, 0);
+
+	//First point of the chunk with the maximum
+	for (i = Chunk; i < Chunk + CORNERS_CHUNK; ++i) {
+		const int Dx = x[i] - from.x, Dy = y[i] - from.y;
+		if (Dx * Dx + Dy * Dy == Dist_max) break;
+	}
+	return i;
+}
+
+template <bool NARROW>
+void FarthestFromLine(const int *x, const int *y, const int nb_points, const Point &a, const Point &b, int ids[2])
+{
+	const Point AB = b - a;
+	//Points on the diagonal (cross product 0) are on no side
+	int Cross_max = 0, Cross_min = 0, Chunks[2] = {0, 0}, i = 0;
+#if CV_SIMD128
+	const v_int32x4 A_x = v_setall_s32(a.x), A_y = v_setall_s32(a.y),
+					AB_x = v_setall_s32(AB.x), AB_y = v_setall_s32(AB.y);
+	const short W_x = short(AB.x), W_y = short(-AB.y);
+	const v_int16x8 W(W_x, W_y, W_x, W_y, W_x, W_y, W_x, W_y);
+	for (; i <= nb_points - CORNERS_CHUNK; i += CORNERS_CHUNK) {
+		v_int32x4 Max = v_setall_s32(0), Min = v_setall_s32(0);
+		for (int k = i; k < i + CORNERS_CHUNK; k += 8) {
+			v_int32x4 Lo, Hi;
+			Cross8<NARROW>(x, y, k, A_x, A_y, AB_x, AB_y, W, Lo, Hi);
+			Max = v_max(Max, v_max(Lo, Hi));
+			Min = v_min(Min, v_min(Lo, Hi));
+		}
+		const int Chunk_max = v_reduce_max(Max), Chunk_min = v_reduce_min(Min);
+		if (Chunk_max > Cross_max) {
+			Cross_max = Chunk_max;
+			Chunks[0] = i;
+		}
+		if (Chunk_min < Cross_min) {
+			Cross_min = Chunk_min;
+			Chunks[1] = i;
+		}
+	}
+#endif
+	ids[0] = ids[1] = -1;
+	for (; i < nb_points; ++i) {
+		const int Cross = AB.x * (y[i] - a.y) - AB.y * (x[i] - a.x);
+		if (Cross > Cross_max) {
+			Cross_max = Cross;
+			ids[0] = i;
+		}
+		else if (Cross < Cross_min) {
+			Cross_min = Cross;
+			ids[1] = i;
+		}
+	}
+
+	//First point of the chunk with the extremum
+	const int Targets[2] = {Cross_max, Cross_min};
+	for (int side = 0; side < 2; ++side) {
+		if (ids[side] >= 0) continue;
+		ids[side] = 0;
+		if (Targets[side] == 0) continue;
+		for (int k = Chunks[side]; k < Chunks[side] + CORNERS_CHUNK; ++k) {
+			if (AB.x * (y[k] - a.y) - AB.y * (x[k] - a.x) == Targets[side]) {
+				ids[side] = k;
+				break;
+			}
+		}
+	}
+}
+
+void QuadCorners(const int *x, const int *y, const int nb_points, int ids[4])
+{
+	ids[0] = ids[1] = ids[2] = ids[3] = 0;
+	if (nb_points <= 0) return;
+
+	//Center (mean of the points) and extent of the contour:
+	//all the points in [first - NARROW_EXTENT / 2, first + NARROW_EXTENT / 2) (one or by coordinate, no min / max)
+	const int Bias_x = NARROW_EXTENT / 2 - x[0], Bias_y = NARROW_EXTENT / 2 - y[0];
+	int Sum_x = 0, Sum_y = 0, Out = 0, i = 0;
+#if CV_SIMD128
+	if (nb_points >= 4) {
+		const v_int32x4 Bias_xv = v_setall_s32(Bias_x), Bias_yv = v_setall_s32(Bias_y);
+		v_int32x4 Sum_xv = v_setall_s32(0), Sum_yv = v_setall_s32(0), Out_v = v_setall_s32(0);
+		for (; i <= nb_points - 4; i += 4) {
+			const v_int32x4 X = v_load(x + i), Y = v_load(y + i);
+			Sum_xv += X;
+			Sum_yv += Y;
+			Out_v = Out_v | (X + Bias_xv) | (Y + Bias_yv);
+		}
+		Sum_x = v_reduce_sum(Sum_xv);
+		Sum_y = v_reduce_sum(Sum_yv);
+		int Outs[4];
+		v_store(Outs, Out_v);
+		Out = Outs[0] | Outs[1] | Outs[2] | Outs[3];
+	}
+#endif
+	for (; i < nb_points; ++i) {
+		Sum_x += x[i];
+		Sum_y += y[i];
+		Out |= (x[i] + Bias_x) | (y[i] + Bias_y);
+	}
+	//Every difference (to the center, to a corner or along the diagonal) is then under NARROW_EXTENT
+	const bool Narrow = (Out & ~(NARROW_EXTENT - 1)) == 0;
+
+	//Diagonal (maximize distance) then the other corners (maximize area on each side)
+	const Point Center(Sum_x / nb_points, Sum_y / nb_points);
+	if (Narrow) {
+		ids[2] = FarthestPoint<true>(x, y, nb_points, Center);
+		ids[3] = FarthestPoint<true>(x, y, nb_points, Point(x[ids[2]], y[ids[2]]));
+		FarthestFromLine<true>(x, y, nb_points, Point(x[ids[2]], y[ids[2]]), Point(x[ids[3]], y[ids[3]]), ids);
+	}
+	else {
+		ids[2] = FarthestPoint<false>(x, y, nb_points, Center);
+		ids[3] = FarthestPoint<false>(x, y, nb_points, Point(x[ids[2]], y[ids[2]]));
+		FarthestFromLine<false>(x, y, nb_points, Point(x[ids[2]], y[ids[2]]), Point(x[ids[3]], y[ids[3]]), ids);
+	}
+}
+
+//***** Hull Quad *****
+void RowsHull(const int *x, const int *y, const int nb_points, HullBuffers &hull)
+{
+	hull.Poly.clear();
+	int Y_min = y[0], Y_max = y[0];
+	for (int i = 1; i < nb_points; ++i) {
+		Y_min = MIN(Y_min, y[i]);
+		Y_max = MAX(Y_max, y[i]);
+	}
+
+	//Leftmost and rightmost x of each row (the buffer only grows)
+	const int Nb_rows = Y_max - Y_min + 1;
+	vector<Point> &Rows = hull.Rows;
+	if (int(Rows.size()) < Nb_rows) Rows.resize(Nb_rows);
+	for (int r = 0; r < Nb_rows; ++r) Rows[r] = Point(INT_MAX, INT_MIN);
+	for (int i = 0; i < nb_points; ++i) {
+		Point &R = Rows[y[i] - Y_min];
+		R.x = MIN(R.x, x[i]);
+		R.y = MAX(R.y, x[i]);
+	}
+
+	//The rows are one pixel apart: an extreme is a candidate only if it is out of the segment of its neighbours
+	//(inside or on it, it is between that segment and the other extreme of its row)
+	vector<Point> &Left = hull.Left, &Right = hull.Right;
+	Left.clear();
+	Right.clear();
+	for (int r = 0; r < Nb_rows; ++r) {
+		const Point &R = Rows[r];
+		if (R.x > R.y) continue;
+		const bool Inner = r > 0 && r < Nb_rows - 1 && Rows[r - 1].x <= Rows[r - 1].y && Rows[r + 1].x <= Rows[r + 1].y;
+		const bool Is_left = !Inner || 2 * R.x < Rows[r - 1].x + Rows[r + 1].x,
+				   Is_right = !Inner || 2 * R.y > Rows[r - 1].y + Rows[r + 1].y;
+		if (Is_left || (R.x == R.y && Is_right)) Left.emplace_back(R.x, r + Y_min);
+		if (Is_right || (R.x == R.y && Is_left)) Right.emplace_back(R.y, r + Y_min);
+	}
+
+	//Monotone chain, the collinear points are removed: from the top left point down the right extremes,
+	//then back up the left ones (an extreme is never a vertex of the other side)
+	const int Nb_left = int(Left.size()), Nb_right = int(Right.size());
+	if (Nb_left + Nb_right < 3) return;
+	vector<Point> &Chain = hull.Chain;
+	if (int(Chain.size()) < Nb_left + Nb_right + 1) Chain.resize(Nb_left + Nb_right + 1);
+	int K = 0;
+	Chain[K++] = Left[0];
+	for (int i = 0; i < Nb_right; ++i) {
+		while (K >= 2 && Cross(Chain[K - 2], Chain[K - 1], Right[i]) <= 0) --K;
+		Chain[K++] = Right[i];
+	}
+	for (int i = Nb_left - 1, Lower = K + 1; i >= 0; --i) {
+		while (K >= Lower && Cross(Chain[K - 2], Chain[K - 1], Left[i]) <= 0) --K;
+		Chain[K++] = Left[i];
+	}
+	for (int k = 0; k < K - 1; ++k) hull.Poly.emplace_back(Chain[k].x, Chain[k].y);
+}
+
+int64_t Cross(const Point &o, const Point &a, const Point &b)
+{
+	return int64_t(a.x - o.x) * (b.y - o.y) - int64_t(a.y - o.y) * (b.x - o.x);
+}
+
+double CollapseCost(const HullBuffers &hull, const int i, Point2d &corner)
+{
+	const int I2 = hull.Next[i];
+	const Point2d &P0 = hull.Poly[hull.Prev[i]], &P1 = hull.Poly[i], &P2 = hull.Poly[I2], &P3 = hull.Poly[hull.Next[I2]];
+	const Point2d D1 = P1 - P0, D2 = P3 - P2, E = P2 - P1;
+	//The two neighbour edges must turn by less than a half turn to meet after P1 and before P2
+	const double Den = D1.cross(D2);
+	if (Den <= 1e-9) return -1;
+	corner = P1 + D1 * (E.cross(D2) / Den);
+	return 0.5 * fabs(E.cross(corner - P1));
+}
+
+bool HullQuad(const int *x, const int *y, const int nb_points, HullBuffers &hull, Point quad[4])
+{
+	if (nb_points < 4) return false;
+	RowsHull(x, y, nb_points, hull);
+	vector<Point2d> &Poly = hull.Poly;
+	const int Nb_hull = int(Poly.size());
+	if (Nb_hull < 4) return false;
+
+	//Edge collapse: the cheapest edge is replaced by the intersection of its neighbours until 4 are left.
+	//The polygon is a list over the hull vertices: a collapse unlinks one vertex and computes the 4 costs it changes
+	//(a scan of the few costs left is cheaper than a heap here, on ties the first vertex goes first)
+	vector<int> &Next = hull.Next, &Prev = hull.Prev;
+	vector<double> &Costs = hull.Costs;
+	vector<Point2d> &Corners = hull.Corners;
+	Next.resize(Nb_hull);
+	Prev.resize(Nb_hull);
+	Costs.resize(Nb_hull);
+	Corners.resize(Nb_hull);
+	for (int k = 0; k < Nb_hull; ++k) {
+		Next[k] = (k + 1) % Nb_hull;
+		Prev[k] = (k + Nb_hull - 1) % Nb_hull;
+	}
+	for (int k = 0; k < Nb_hull; ++k) Costs[k] = CollapseCost(hull, k, Corners[k]);
+	int First = 0;		// First vertex left, in the order of the hull
+	for (int Nb_left = Nb_hull; Nb_left > 4; --Nb_left) {
+		int Best = -1;
+		for (int k = 0, v = First; k < Nb_left; ++k, v = Next[v]) {
+			if (Costs[v] >= 0 && (Best < 0 || Costs[v] < Costs[Best])) Best = v;
+		}
+		if (Best < 0) return false;
+		//The vertices Best and Next[Best] become one, only the costs of the 4 edges around it change
+		const int Gone = Next[Best];
+		Poly[Best] = Corners[Best];
+		Next[Best] = Next[Gone];
+		Prev[Next[Gone]] = Best;
+		if (Gone == First) First = Next[Best];
+		for (const int k : {Prev[Prev[Best]], Prev[Best], Best, Next[Best]}) Costs[k] = CollapseCost(hull, k, Corners[k]);
+	}
+
+	//Counterclockwise on the image from the top left corner (smallest x + y), the order of QuadCorners
+	Point2d Vertices[4];
+	for (int k = 0, v = First; k < 4; ++k, v = Next[v]) Vertices[k] = Poly[v];
+	First = 0;
+	for (int k = 1; k < 4; ++k) {
+		if (Vertices[k].x + Vertices[k].y < Vertices[First].x + Vertices[First].y) First = k;
+	}
+	for (int k = 0; k < 4; ++k) {
+		const Point2d &P = Vertices[(First - k + 4) % 4];	// The hull is clockwise on the image
+		quad[k] = Point(cvRound(P.x), cvRound(P.y));
+	}
+	return true;
+}
+
+//***** Edges *****
+// Stages lag one row behind each other: gray row t, blurred row t - 1, gradients row t - 2, suppression row t - 3.
+// Every stage keeps only the 3 rows its 3x3 window needs, they stay in cache from one stage to the next.
+void EdgeRuns::Add(const int row, const int x0, const int x1, const bool strong)
+{
+	Parent.push_back(Size());
+	Row.push_back(row);
+	X0.push_back(x0);
+	X1.push_back(x1);
+	Strong.push_back(strong ? 1 : 0);
+}
+
+int EdgeRuns::Find(int i)
+{
+	while (Parent[i] != i) {
+		Parent[i] = Parent[Parent[i]];
+		i = Parent[i];
+	}
+	return i;
+}
+
+void EdgeRuns::Union(int a, int b)
+{
+	a = Find(a);
+	b = Find(b);
+	if (a == b) return;
+	if (b < a) std::swap(a, b);
+	Parent[b] = a;
+	Strong[a] |= Strong[b];
+}
+
+void EdgeRuns::Append(const EdgeRuns &runs)
+{
+	const int Base = Size();
+	Row.insert(Row.end(), runs.Row.begin(), runs.Row.end());
+	X0.insert(X0.end(), runs.X0.begin(), runs.X0.end());
+	X1.insert(X1.end(), runs.X1.begin(), runs.X1.end());
+	Strong.insert(Strong.end(), runs.Strong.begin(), runs.Strong.end());
+	for (const int P : runs.Parent) Parent.push_back(P + Base);
+}
+
+void EdgeRuns::Connect(const int prev_begin, const int begin, const int end)
+{
+	//Both lists are sorted on x
+	int p = prev_begin;
+	for (int i = begin; i < end; ++i) {
+		while (p < begin && X1[p] < X0[i] - 1) ++p;
+		for (int q = p; q < begin && X0[q] <= X1[i] + 1; ++q) Union(i, q);
+	}
+}
+
+template <int CN, bool RGB>
+void GrayRow(const uchar *src, const int width, uchar *dst)
+{
+	if (CN == 1) {
+		memcpy(dst, src, width);
+		return;
+	}
+	const int R = RGB ? 0 : 2, B = RGB ? 2 : 0;
+	int x = 0;
+#if CV_SIMD128
+	//(r, g) and (b, 1) pairs: two dot products by pixel on 16 bits
+	const v_int16x8 Coeffs_rg = v_reinterpret_as_s16(v_setall_s32((GRAY_G << 16) | GRAY_R)),
+					Coeffs_b1 = v_reinterpret_as_s16(v_setall_s32(((1 << (GRAY_SHIFT - 1)) << 16) | GRAY_B)),
+					One = v_setall_s16(1);
+	for (; x <= width - 16; x += 16) {
+		v_uint8x16 C[4];
+		if (CN == 4) v_load_deinterleave(src + 4 * x, C[0], C[1], C[2], C[3]);
+		else v_load_deinterleave(src + 3 * x, C[0], C[1], C[2]);
+		v_uint16x8 R_lo, R_hi, G_lo, G_hi, B_lo, B_hi;
+		v_expand(C[R], R_lo, R_hi);
+		v_expand(C[1], G_lo, G_hi);
+		v_expand(C[B], B_lo, B_hi);
+		v_int16x8 Rg[4], B1[4];
+		v_zip(v_reinterpret_as_s16(R_lo), v_reinterpret_as_s16(G_lo), Rg[0], Rg[1]);
+		v_zip(v_reinterpret_as_s16(R_hi), v_reinterpret_as_s16(G_hi), Rg[2], Rg[3]);
+		v_zip(v_reinterpret_as_s16(B_lo), One, B1[0], B1[1]);
+		v_zip(v_reinterpret_as_s16(B_hi), One, B1[2], B1[3]);
+		v_int32x4 Y[4];
+		for (int k = 0; k < 4; ++k) {
+			Y[k] = v_shr<GRAY_SHIFT>(v_dotprod(Rg[k], Coeffs_rg) + v_dotprod(B1[k], Coeffs_b1));
+		}
+		v_store(dst + x, v_pack_u(v_pack(Y[0], Y[1]), v_pack(Y[2], Y[3])));
+	}
+#endif
+	for (; x < width; ++x) {
+		const uchar *P = src + CN * x;
+		dst[x] = uchar((P[R] * GRAY_R + P[1] * GRAY_G + P[B] * GRAY_B + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+	}
+}
+
+void BlurRow(const uchar *up, const uchar *row, const uchar *down, const int width, ushort *sums, uchar *dst)
+{
+	//Vertical sums with the reflected columns -1 and width, then horizontal sums
+	ushort *Sums = sums + 1;
+	int x = 0;
+#if CV_SIMD128
+	for (; x <= width - 16; x += 16) {
+		v_uint16x8 U_lo, U_hi, R_lo, R_hi, D_lo, D_hi;
+		v_expand(v_load(up + x), U_lo, U_hi);
+		v_expand(v_load(row + x), R_lo, R_hi);
+		v_expand(v_load(down + x), D_lo, D_hi);
+		v_store(Sums + x, U_lo + R_lo + D_lo);
+		v_store(Sums + x + 8, U_hi + R_hi + D_hi);
+	}
+#endif
+	for (; x < width; ++x) {
+		Sums[x] = ushort(up[x] + row[x] + down[x]);
+	}
+	Sums[-1] = Sums[1];
+	Sums[width] = Sums[width - 2];
+
+	//Rounded division by 9: (s * 7282) >> 16 is exact up to 9 * 255 + 4
+	x = 0;
+#if CV_SIMD128
+	const v_uint16x8 Four = v_setall_u16(4), Inv_9 = v_setall_u16(7282);
+	for (; x <= width - 16; x += 16) {
+		v_uint16x8 S[2];
+		for (int k = 0; k < 2; ++k) {
+			const int i = x + 8 * k;
+			S[k] = v_load(Sums + i - 1) + v_load(Sums + i) + v_load(Sums + i + 1) + Four;
+			v_uint32x4 Lo, Hi;
+			v_mul_expand(S[k], Inv_9, Lo, Hi);
+			S[k] = v_pack(v_shr<16>(Lo), v_shr<16>(Hi));
+		}
+		v_store(dst + x, v_pack(S[0], S[1]));
+	}
+#endif
+	for (; x < width; ++x) {
+		dst[x] = uchar((Sums[x - 1] + Sums[x] + Sums[x + 1] + 4) / 9);
+	}
+}
+
+void SobelRow(const uchar *up, const uchar *row, const uchar *down, const int width, short *dx, short *dy, short *mag)
+{
+	//Rows padded by one replicated pixel on each side
+	int x = 0;
+#if CV_SIMD128
+	for (; x <= width - 8; x += 8) {
+		const v_int16x8 U0 = v_reinterpret_as_s16(v_load_expand(up + x)),
+						U1 = v_reinterpret_as_s16(v_load_expand(up + x + 1)),
+						U2 = v_reinterpret_as_s16(v_load_expand(up + x + 2)),
+						R0 = v_reinterpret_as_s16(v_load_expand(row + x)),
+						R2 = v_reinterpret_as_s16(v_load_expand(row + x + 2)),
+						D0 = v_reinterpret_as_s16(v_load_expand(down + x)),
+						D1 = v_reinterpret_as_s16(v_load_expand(down + x + 1)),
+						D2 = v_reinterpret_as_s16(v_load_expand(down + x + 2));
+		const v_int16x8 Dx = (U2 - U0) + (R2 - R0) + (R2 - R0) + (D2 - D0),
+						Dy = (D0 + D1 + D1 + D2) - (U0 + U1 + U1 + U2);
+		v_store(dx + x, Dx);
+		v_store(dy + x, Dy);
+		v_store(mag + x, v_reinterpret_as_s16(v_abs(Dx) + v_abs(Dy)));
+	}
+#endif
+	for (; x < width; ++x) {
+		const int Dx = (up[x + 2] - up[x]) + 2 * (row[x + 2] - row[x]) + (down[x + 2] - down[x]),
+				  Dy = (down[x] + 2 * down[x + 1] + down[x + 2]) - (up[x] + 2 * up[x + 1] + up[x + 2]);
+		dx[x] = short(Dx);
+		dy[x] = short(Dy);
+		mag[x] = short(abs(Dx) + abs(Dy));
+	}
+}
+
+void SuppressionRow(const short *up, const short *mag, const short *down, const short *dx, const short *dy,
+					const int width, const int row, const int low, const int high, EdgeRuns &runs)
+{
+	//Same comparisons as Canny (strict on one side of the gradient, not on the other)
+	int Run_begin = -1;
+	bool Run_strong = false;
+	int x = 0;
+#if CV_SIMD128
+	const v_int16x8 Low = v_setall_s16(short(low));
+#endif
+	while (x < width) {
+#if CV_SIMD128
+		//Most of the pixels are under the low threshold: 8 at once
+		if (Run_begin < 0 && x <= width - 8 && !v_check_any(v_load(mag + x) > Low)) {
+			x += 8;
+			continue;
+		}
+#endif
+		const int M = mag[x];
+		bool Candidate = false;
+		if (M > low) {
+			const int Xs = dx[x], Ys = dy[x], Ax = abs(Xs), Ay = abs(Ys) << CANNY_SHIFT;
+			const int Tg22x = Ax * CANNY_TG22;
+			if (Ay < Tg22x) {
+				Candidate = M > mag[x - 1] && M >= mag[x + 1];
+			}
+			else if (Ay > Tg22x + (Ax << (CANNY_SHIFT + 1))) {
+				Candidate = M > up[x] && M >= down[x];
+			}
+			else {
+				const int S = (Xs ^ Ys) < 0 ? -1 : 1;
+				Candidate = M > up[x - S] && M > down[x + S];
+			}
+		}
+		if (Candidate) {
+			if (Run_begin < 0) Run_begin = x;
+			Run_strong = Run_strong || M > high;
+		}
+		else if (Run_begin >= 0) {
+			runs.Add(row, Run_begin, x - 1, Run_strong);
+			Run_begin = -1;
+			Run_strong = false;
+		}
+		++x;
+	}
+	if (Run_begin >= 0) runs.Add(row, Run_begin, width - 1, Run_strong);
+}
+
+template <int CN, bool RGB>
+void EdgeBand(const uchar *data, const size_t step, const int width, const int height, const int begin, const int end,
+			  const int low, const int high, EdgeRuns &runs, Mat &dst)
+{
+	const int W = width, H = height, P = W + 2;
+	vector<uchar> Gray(3 * W), Blurred(3 * P);
+	vector<ushort> Sums(P);
+	vector<short> Dx(3 * W), Dy(3 * W), Mag(4 * P, 0);	// The 4th magnitude row stays at 0 (outside the image)
+	const short *Zeros = Mag.data() + 3 * P + 1;
+	int Prev_begin = 0;
+
+	//The 3 rows above the band are computed again for the windows (not the ones outside the image)
+	for (int t = MAX(begin - 3, 0); t < MIN(end, H) + 3; ++t) {
+		if (t < H) GrayRow<CN, RGB>(data + size_t(t) * step, W, &Gray[(t % 3) * W]);
+
+		const int b = t - 1;
+		if (MAX(begin - 2, 0) <= b && b < H) {
+			const int Up = b == 0 ? 1 : b - 1, Down = b == H - 1 ? H - 2 : b + 1;
+			uchar *Row = &Blurred[(b % 3) * P];
+			BlurRow(&Gray[(Up % 3) * W], &Gray[(b % 3) * W], &Gray[(Down % 3) * W], W, Sums.data(), Row + 1);
+			Row[0] = Row[1];
+			Row[W + 1] = Row[W];
+		}
+
+		const int s = t - 2;
+		if (MAX(begin - 1, 0) <= s && s < H) {
+			const int Up = MAX(s - 1, 0), Down = MIN(s + 1, H - 1);
+			SobelRow(&Blurred[(Up % 3) * P], &Blurred[(s % 3) * P], &Blurred[(Down % 3) * P], W,
+					 &Dx[(s % 3) * W], &Dy[(s % 3) * W], &Mag[(s % 3) * P + 1]);
+		}
+
+		const int n = t - 3;
+		if (begin <= n && n < end) {
+			const short *Up = n > 0 ? &Mag[((n - 1) % 3) * P + 1] : Zeros,
+						*Down = n < H - 1 ? &Mag[((n + 1) % 3) * P + 1] : Zeros;
+			const int Begin = runs.Size();
+			SuppressionRow(Up, &Mag[(n % 3) * P + 1], Down, &Dx[(n % 3) * W], &Dy[(n % 3) * W], W, n, low, high, runs);
+			memset(dst.ptr<uchar>(n), 0, W);
+			runs.Connect(Prev_begin, Begin, runs.Size());
+			Prev_begin = Begin;
+		}
+	}
+}
+
+template <int CN, bool RGB>
+void EdgeKernel(const uchar *data, const size_t step, const int width, const int height, const int low, const int high,
+				const int nb_threads, Mat &dst)
+{
+	dst.create(height, width, CV_8UC1);
+	const int Nb_bands = BandsCount(height, nb_threads);
+	vector<EdgeRuns> Bands(Nb_bands);
+	vector<int> Begins(Nb_bands);
+	ParallelBands(height, Nb_bands, nb_threads, [&](const int band, const int begin, const int end) {
+		Begins[band] = begin;
+		EdgeBand<CN, RGB>(data, step, width, height, begin, end, low, high, Bands[band], dst);
+	});
+
+	//Stitching: the runs of the last row of a band with the ones of the first row of the next band
+	EdgeRuns &Runs = Bands[0];
+	for (int band = 1; band < Nb_bands; ++band) {
+		int Prev_begin = Runs.Size();
+		while (Prev_begin > 0 && Runs.Row[Prev_begin - 1] == Begins[band] - 1) --Prev_begin;
+		const int Begin = Runs.Size();
+		Runs.Append(Bands[band]);
+		int End = Begin;
+		while (End < Runs.Size() && Runs.Row[End] == Begins[band]) ++End;
+		Runs.Connect(Prev_begin, Begin, End);
+	}
+
+	//Hysteresis: every run connected to a strong pixel
+	for (int i = 0; i < Runs.Size(); ++i) {
+		if (Runs.Strong[Runs.Find(i)]) memset(dst.ptr<uchar>(Runs.Row[i]) + Runs.X0[i], 255, Runs.X1[i] - Runs.X0[i] + 1);
+	}
+}
+
+int EdgeMap(const Color32 *image, const uint width, const uint height, Mat &dst, const int min_tresh,
+			const int max_tresh, const int nb_threads)
+{
+	if (image == nullptr || width == 0 || height == 0) return EMPTY_MAT;
+	const Mat Src(int(height), int(width), CV_8UC4, const_cast<Color32 *>(image));
+	if (width < 3 || height < 3) {
+		Mat Bgr;
+		cvtColor(Src, Bgr, CV_RGBA2BGR);
+		return BinaryEdgeDetector(Bgr, dst, min_tresh, max_tresh);
+	}
+	EdgeKernel<4, true>(Src.data, Src.step, Src.cols, Src.rows, MIN(min_tresh, max_tresh), MAX(min_tresh, max_tresh),
+						nb_threads, dst);
+	return NO_ERRORS;
+}
+
+int EdgeMap(const Mat &src, Mat &dst, const int min_tresh, const int max_tresh, const int nb_threads)
+{
+	if (src.empty()) return EMPTY_MAT;
+	if (src.type() != CV_8UC1 && src.type() != CV_8UC3) return TYPE_MAT;
+	if (src.cols < 3 || src.rows < 3) return BinaryEdgeDetector(src, dst, min_tresh, max_tresh);
+	const int Low = MIN(min_tresh, max_tresh), High = MAX(min_tresh, max_tresh);
+	if (src.channels() == 1) EdgeKernel<1, false>(src.data, src.step, src.cols, src.rows, Low, High, nb_threads, dst);
+	else EdgeKernel<3, false>(src.data, src.step, src.cols, src.rows, Low, High, nb_threads, dst);
+	return NO_ERRORS;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "DocDetector.hpp"
+#include "ColorTable.hpp"
+
+//*****************************
+//********** Kernels **********
+//*****************************
+// Kernels working straight on the raw buffers,
+// vectorised with the OpenCV universal intrinsics (SSE2 / NEON) when they are available.
+
+/// <summary>
+/// Background mask of a Unity image in one pass (instead of RGBA->BGR conversion + inRange).
+/// </summary>
+/// <param name="image">Unity image.</param>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="lower">The lower background color (BGR like OpenCV).</param>
+/// <param name="higher">The higher background color (BGR like OpenCV).</param>
+/// <param name="dst">single-channel 8-bit binary image, 255 on the background (written in place if it already has the good size).</param>
+/// <param name="scale">Only one pixel every scale pixels is tested (1, 2, 4 or 8), dst is ceil(width / scale) x ceil(height / scale).</param>
+/// <param name="nb_threads">Number of threads, on horizontal bands (0: one by core).</param>
+/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+int BackgroundMask(const Color32 *image, uint width, uint height,
+				   const cv::Scalar &lower, const cv::Scalar &higher, cv::Mat &dst, uint scale = 1, int nb_threads = 1);
+
+/// <summary>Background mask of a tri-channel 8-bit image (BGR).</summary>
+int BackgroundMask(const cv::Mat &src, const cv::Scalar &lower, const cv::Scalar &higher, cv::Mat &dst, uint scale = 1,
+				   int nb_threads = 1);
+
+/// <summary>Background mask of a Unity image with any set of background colors (one table lookup by pixel).</summary>
+/// <param name="table">The background colors.</param>
+int BackgroundMask(const Color32 *image, uint width, uint height, const ColorTable &table, cv::Mat &dst, uint scale = 1,
+				   int nb_threads = 1);
+
+/// <summary>Background mask of a tri-channel 8-bit image (BGR) with a color table.</summary>
+int BackgroundMask(const cv::Mat &src, const ColorTable &table, cv::Mat &dst, uint scale = 1, int nb_threads = 1);
+
+/// <summary>
+/// Corners refinement of a quad detected on a 1/scale mask (<see cref = "BackgroundMask"/>).
+/// Each corner is moved to the full resolution background border,
+/// in a window of 2 coarse pixels around its upscaled position.
+/// </summary>
+/// <param name="image">Unity image.</param>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="lower">The lower background color (BGR like OpenCV).</param>
+/// <param name="higher">The higher background color (BGR like OpenCV).</param>
+/// <param name="scale">Scale of the mask the quad comes from.</param>
+/// <param name="quad">The 4 corners (in order) in coarse coordinates, full resolution ones at the end.</param>
+/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+int RefineCorners(const Color32 *image, uint width, uint height,
+				  const cv::Scalar &lower, const cv::Scalar &higher, uint scale, std::vector<cv::Point> &quad);
+
+/// <summary>Corners refinement on a tri-channel 8-bit image (BGR).</summary>
+int RefineCorners(const cv::Mat &src, const cv::Scalar &lower, const cv::Scalar &higher, uint scale,
+				  std::vector<cv::Point> &quad);
+
+/// <summary>Corners refinement with a color table.</summary>
+int RefineCorners(const Color32 *image, uint width, uint height, const ColorTable &table, uint scale,
+				  std::vector<cv::Point> &quad);
+
+int RefineCorners(const cv::Mat &src, const ColorTable &table, uint scale, std::vector<cv::Point> &quad);
+
+/// <summary>
+/// Local search of the corners of a full resolution quad (tracking).
+/// Each corner is moved to the background border in a (2 * radius + 1) window around it.
+/// </summary>
+/// <param name="image">Unity image.</param>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="lower">The lower background color (BGR like OpenCV).</param>
+/// <param name="higher">The higher background color (BGR like OpenCV).</param>
+/// <param name="radius">Search radius in pixels (16 at most).</param>
+/// <param name="quad">The 4 corners (in order).</param>
+/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+int SearchCorners(const Color32 *image, uint width, uint height,
+				  const cv::Scalar &lower, const cv::Scalar &higher, uint radius, std::vector<cv::Point> &quad);
+
+/// <summary>Local search of the corners with a color table.</summary>
+int SearchCorners(const Color32 *image, uint width, uint height, const ColorTable &table, uint radius,
+				  std::vector<cv::Point> &quad);
+
+/// <summary>
+/// Border contrast of a quad: ratio of the samples along its sides
+/// with the background just outside and not just inside.
+/// </summary>
+/// <param name="image">Unity image.</param>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="lower">The lower background color (BGR like OpenCV).</param>
+/// <param name="higher">The higher background color (BGR like OpenCV).</param>
+/// <param name="quad">The 4 corners (in order).</param>
+/// <returns>Score between 0 and 1.</returns>
+double BorderScore(const Color32 *image, uint width, uint height,
+				   const cv::Scalar &lower, const cv::Scalar &higher, const std::vector<cv::Point> &quad);
+
+/// <summary>Border contrast of a quad with a color table.</summary>
+double BorderScore(const Color32 *image, uint width, uint height, const ColorTable &table,
+				   const std::vector<cv::Point> &quad);
+
+/// <summary>
+/// Corners of a contour stored as separate x and y arrays (<see cref = "ContourSet"/>):
+/// the diagonal (farthest point from the center, then farthest point from it)
+/// and the farthest point on each side of the diagonal.
+/// Integer squared distances and cross products only (the cross product is twice the triangle area on a fixed base).
+/// </summary>
+/// <param name="x">The x of the points.</param>
+/// <param name="y">The y of the points.</param>
+/// <param name="nb_points">Number of points.</param>
+/// <param name="ids">Indexes of the corners, 0: left of the diagonal, 1: right of it, 2 and 3: the diagonal
+/// (first point of each scan on ties, 0 when a side is empty).</param>
+void QuadCorners(const int *x, const int *y, int nb_points, int ids[4]);
+
+/// <summary>
+/// Quad enclosing a contour stored as separate x and y arrays (<see cref = "ContourSet"/>).
+/// The convex hull is computed in linear time (the rows give the order), then its edges are collapsed:
+/// the edge adding the smallest area when its two neighbours are extended to their intersection goes first,
+/// until 4 edges are left. A rounded or cut corner is collapsed into its real corner.
+/// Only the hull vertices are visited after the first pass (a few tens for a document).
+/// </summary>
+/// <param name="x">The x of the points.</param>
+/// <param name="y">The y of the points.</param>
+/// <param name="nb_points">Number of points.</param>
+/// <param name="hull">Buffers of the fit (<see cref = "HullBuffers"/>).</param>
+/// <param name="quad">The 4 corners, counterclockwise on the image from the top left one (smallest x + y) like QuadCorners.</param>
+/// <returns><c>False</c> if the hull has less than 4 vertices or can't be reduced to a quad.</returns>
+bool HullQuad(const int *x, const int *y, int nb_points, HullBuffers &hull, cv::Point quad[4]);
+
+/// <summary>
+/// Canny edges of a Unity image in one sweep (instead of RGBA->BGR conversion, gray conversion, 3x3 blur and Canny):
+/// gray, blur, Sobel and non-maximum suppression are streamed row by row on a few rows kept in cache,
+/// the hysteresis is a union-find on the runs of candidates.
+/// Opt-in: nearly the edges of <see cref = "BinaryEdgeDetector"/> with the box blur and a 3 aperture (L1 gradient),
+/// 41 pixels differ from Canny on 2 of 164 test images, the detection still calls BinaryEdgeDetector.
+/// With several threads each horizontal band is swept on its own (with the 3 rows above it for the windows),
+/// then the runs of the bands are connected at their limits before the hysteresis: the edges don't change.
+/// </summary>
+/// <param name="image">Unity image.</param>
+/// <param name="width">Image width.</param>
+/// <param name="height">Image height.</param>
+/// <param name="dst">8-bit, single-channel binary image (written in place if it already has the good size).</param>
+/// <param name="min_tresh">first threshold for the hysteresis procedure.</param>
+/// <param name="max_tresh">second threshold for the hysteresis procedure.</param>
+/// <param name="nb_threads">Number of threads (0: one by core).</param>
+/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+int EdgeMap(const Color32 *image, uint width, uint height, cv::Mat &dst, int min_tresh = 50, int max_tresh = 205,
+			int nb_threads = 1);
+
+/// <summary>Canny edges in one sweep of a single or tri-channel (BGR) 8-bit image.</summary>
+int EdgeMap(const cv::Mat &src, cv::Mat &dst, int min_tresh = 50, int max_tresh = 205, int nb_threads = 1);
@@ -0,0 +1,371 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "LinesQuads.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+using namespace cv;
+
+// Size of the cells of the spatial hash (pixels), minimum side of a document
+// and length of a line checked past a corner (pixels)
+static const float LINES_GRID_CELL = 32, LINES_MIN_SIDE = 30, LINES_PAST_CORNER = 16;
+
+//**********************************
+//********** DECLARATIONS **********
+//**********************************
+/// <summary>Line made of a group of collinear segments.</summary>
+struct MergedLine
+{
+	Point2f Origin, Dir;	// Point and unit direction of the line
+	float Angle;			// Angle of Dir in [0, pi)
+	float T_min, T_max;		// Extent of the segments along Dir (from Origin)
+	vector<Vec2f> Covered;	// Sorted and disjoint intervals of the line covered by the segments
+};
+
+/// <summary>Perpendicular intersection with another line.</summary>
+struct LineCorner
+{
+	int Line;
+	Point2f Corner;
+};
+
+static int FindRoot(vector<int> &parent, int i);
+
+static int64 CellKey(int x, int y);
+
+/// <summary>Angle between two directions in [0, pi / 2].</summary>
+static float AngleDiff(float a, float b);
+
+/// <summary>Ratio of [t0, t1] covered by the segments of the line.</summary>
+static float Coverage(const MergedLine &line, float t0, float t1);
+
+static bool Intersection(const MergedLine &a, const MergedLine &b, Point2f &p);
+
+/// <summary>Both ends of the segment b within dist_tresh of the line of the segment a (of angle angle_a).</summary>
+static bool OnLine(const Vec4i &a, float angle_a, const Vec4i &b, double dist_tresh);
+
+/// <summary>
+/// Step 1: groups of collinear segments (same angle, the ends of the shorter one close to the line of the longer one).
+/// The segments are hashed on (angle, distance to the origin) so each one is only compared to the ones of the 9
+/// neighbour cells, the distance cells are wide enough for the angle tolerance anywhere in the image.
+/// </summary>
+static void MergeSegments(const vector<Vec4i> &lines, double angle_tresh, double dist_tresh, vector<MergedLine> &merged);
+
+/// <summary>
+/// Steps 2 and 3: the lines are extended on both sides (max_extension of their length)
+/// and hashed on a grid of cells, only the lines crossing the same cell are intersected.
+/// </summary>
+/// <param name="pairs">Corner of each pair of lines (smallest index first).</param>
+static void LineCorners(const vector<MergedLine> &merged, double perpendicular_tresh, double max_extension,
+						vector<vector<LineCorner>> &corners, unordered_map<int64, Point2f> &pairs);
+
+/// <summary>
+/// Side of a document on a line: long enough, covered by enough segments and ended by its corners
+/// (the line isn't covered past them, the side of another document going through a corner isn't a side).
+/// </summary>
+static bool GoodSide(const MergedLine &line, const Point2f &p0, const Point2f &p1, double min_coverage);
+
+//*********************************
+//********** DEFINITIONS **********
+//*********************************
+int FindRoot(vector<int> &parent, int i)
+{
+	while (parent[i] != i) i = parent[i] = parent[parent[i]];
+	return i;
+}
+
+int64 CellKey(const int x, const int y)
+{
+	return (int64(x) << 32) ^ int64(unsigned(y));
+}
+
+float AngleDiff(const float a, const float b)
+{
+	const float D = fabs(a - b);
+	return D > CV_PI / 2 ? float(CV_PI) - D : D;
+}
+
+float Coverage(const MergedLine &line, float t0, float t1)
+{
+	if (t1 < t0) swap(t0, t1);
+	if (t1 - t0 < 1e-3f) return 0;
+	float Inside = 0;
+	for (const Vec2f &C : line.Covered) {
+		Inside += MAX(0.f, MIN(t1, C[1]) - MAX(t0, C[0]));
+	}
+	return Inside / (t1 - t0);
+}
+
+bool Intersection(const MergedLine &a, const MergedLine &b, Point2f &p)
+{
+	const float Cross = a.Dir.cross(b.Dir);
+	if (fabs(Cross) < 1e-6f) return false;
+	p = a.Origin + a.Dir * ((b.Origin - a.Origin).cross(b.Dir) / Cross);
+	return true;
+}
+
+void GridCells(const Point2f &p0, const Point2f &p1, const float cell, vector<Point> &cells)
+{
+	cells.clear();
+	int X = cvFloor(p0.x / cell), Y = cvFloor(p0.y / cell);
+	const int X_end = cvFloor(p1.x / cell), Y_end = cvFloor(p1.y / cell);
+	const Point2f D = p1 - p0;
+	const int Step_x = D.x > 0 ? 1 : -1, Step_y = D.y > 0 ? 1 : -1;
+	// Parameters (0 at p0, 1 at p1) of the next vertical and horizontal borders, and between two borders
+	const float Dt_x = D.x != 0 ? cell / fabs(D.x) : FLT_MAX, Dt_y = D.y != 0 ? cell / fabs(D.y) : FLT_MAX;
+	float T_x = D.x != 0 ? (Step_x > 0 ? (X + 1) * cell - p0.x : p0.x - X * cell) / fabs(D.x) : FLT_MAX,
+		  T_y = D.y != 0 ? (Step_y > 0 ? (Y + 1) * cell - p0.y : p0.y - Y * cell) / fabs(D.y) : FLT_MAX;
+	cells.emplace_back(X, Y);
+	// The walk ends in the cell of p1 whatever the rounding of the parameters
+	while (X != X_end || Y != Y_end) {
+		if (X != X_end && Y != Y_end && fabs(T_x - T_y) <= 1e-5f * MAX(1.f, MIN(T_x, T_y))) {
+			// Through a corner: the two cells beside it, then the diagonal one
+			cells.emplace_back(X + Step_x, Y);
+			cells.emplace_back(X, Y + Step_y);
+			X += Step_x;
+			Y += Step_y;
+			T_x += Dt_x;
+			T_y += Dt_y;
+		}
+		else if (Y == Y_end || (X != X_end && T_x < T_y)) {
+			X += Step_x;
+			T_x += Dt_x;
+		}
+		else {
+			Y += Step_y;
+			T_y += Dt_y;
+		}
+		cells.emplace_back(X, Y);
+	}
+}
+
+bool OnLine(const Vec4i &a, const float angle_a, const Vec4i &b, const double dist_tresh)
+{
+	const Point2f Dir(cos(angle_a), sin(angle_a)), Origin = Point2f(float(a[0]), float(a[1]));
+	return fabs(Dir.cross(Point2f(float(b[0]), float(b[1])) - Origin)) <= dist_tresh
+		   && fabs(Dir.cross(Point2f(float(b[2]), float(b[3])) - Origin)) <= dist_tresh;
+}
+
+void MergeSegments(const vector<Vec4i> &lines, const double angle_tresh, const double dist_tresh, vector<MergedLine> &merged)
+{
+	const int Nb = int(lines.size());
+	const int Nb_angle_bins = MAX(1, cvFloor(CV_PI / angle_tresh));
+	vector<float> Angle(Nb), Rho(Nb), Length(Nb);
+	float Radius = 0;	// Farthest end from the origin
+	for (int i = 0; i < Nb; ++i) {
+		const Point2f P1(float(lines[i][0]), float(lines[i][1])), P2(float(lines[i][2]), float(lines[i][3]));
+		float A = atan2(P2.y - P1.y, P2.x - P1.x);
+		if (A < 0) A += float(CV_PI);
+		if (A >= CV_PI) A -= float(CV_PI);
+		Angle[i] = A;
+		Rho[i] = -sin(A) * P1.x + cos(A) * P1.y;	// Signed distance of the line to the origin
+		Length[i] = float(norm(P2 - P1));
+		Radius = MAX(Radius, float(MAX(norm(P1), norm(P2))));
+	}
+	// Two collinear segments with angle_tresh between them have distances to the origin up to angle_tresh x Radius apart
+	const double Rho_cell = dist_tresh + angle_tresh * Radius;
+	unordered_map<int64, vector<int>> Hash;
+	for (int i = 0; i < Nb; ++i) {
+		const int A_bin = MIN(Nb_angle_bins - 1, int(Angle[i] * Nb_angle_bins / CV_PI));
+		Hash[CellKey(A_bin, cvFloor(Rho[i] / Rho_cell))].push_back(i);
+	}
+
+	vector<int> Parent(Nb);
+	for (int i = 0; i < Nb; ++i) Parent[i] = i;
+	for (int i = 0; i < Nb; ++i) {
+		const int A_bin = MIN(Nb_angle_bins - 1, int(Angle[i] * Nb_angle_bins / CV_PI));
+		for (int da = -1; da <= 1; ++da) {
+			// Angles 0 and pi are the same direction, the distance changes of sign
+			int A = A_bin + da;
+			float R = Rho[i];
+			if (A < 0 || A >= Nb_angle_bins) {
+				A = (A + Nb_angle_bins) % Nb_angle_bins;
+				R = -R;
+			}
+			const int R_bin = cvFloor(R / Rho_cell);
+			for (int dr = -1; dr <= 1; ++dr) {
+				const auto It = Hash.find(CellKey(A, R_bin + dr));
+				if (It == Hash.end()) continue;
+				for (const int j : It->second) {
+					if (j <= i || AngleDiff(Angle[i], Angle[j]) > angle_tresh) continue;
+					// The longer segment gives the more accurate line
+					const int Long = Length[i] >= Length[j] ? i : j, Short = i + j - Long;
+					if (!OnLine(lines[Long], Angle[Long], lines[Short], dist_tresh)) continue;
+					Parent[FindRoot(Parent, j)] = FindRoot(Parent, i);
+				}
+			}
+		}
+	}
+
+	// Fit of each group: length weighted direction (on the doubled angle) and center
+	vector<int> Group(Nb, -1);
+	vector<Vec4f> Sums;		// cos 2a, sin 2a, x, y (weighted by the length)
+	vector<float> Weights;
+	for (int i = 0; i < Nb; ++i) {
+		const int Root = FindRoot(Parent, i);
+		if (Group[Root] < 0) {
+			Group[Root] = int(Sums.size());
+			Sums.emplace_back(0, 0, 0, 0);
+			Weights.push_back(0);
+		}
+		const int G = Group[i] = Group[Root];
+		const float L = Length[i];
+		Sums[G] += Vec4f(L * cos(2 * Angle[i]), L * sin(2 * Angle[i]), L * 0.5f * (lines[i][0] + lines[i][2]),
+						 L * 0.5f * (lines[i][1] + lines[i][3]));
+		Weights[G] += L;
+	}
+	merged.assign(Sums.size(), MergedLine());
+	for (size_t g = 0; g < Sums.size(); ++g) {
+		MergedLine &Line = merged[g];
+		float A = 0.5f * atan2(Sums[g][1], Sums[g][0]);
+		if (A < 0) A += float(CV_PI);
+		Line.Angle = A;
+		Line.Dir = Point2f(cos(A), sin(A));
+		Line.Origin = Weights[g] > 0 ? Point2f(Sums[g][2], Sums[g][3]) / Weights[g] : Point2f();
+	}
+	for (int i = 0; i < Nb; ++i) {
+		MergedLine &Line = merged[Group[i]];
+		const float T1 = Line.Dir.dot(Point2f(float(lines[i][0]), float(lines[i][1])) - Line.Origin),
+					T2 = Line.Dir.dot(Point2f(float(lines[i][2]), float(lines[i][3])) - Line.Origin);
+		Line.Covered.emplace_back(MIN(T1, T2), MAX(T1, T2));
+	}
+	for (MergedLine &Line : merged) {
+		sort(Line.Covered.begin(), Line.Covered.end(), [](const Vec2f &a, const Vec2f &b) { return a[0] < b[0]; });
+		size_t Last = 0;
+		for (size_t k = 1; k < Line.Covered.size(); ++k) {
+			if (Line.Covered[k][0] <= Line.Covered[Last][1]) {
+				Line.Covered[Last][1] = MAX(Line.Covered[Last][1], Line.Covered[k][1]);
+			}
+			else Line.Covered[++Last] = Line.Covered[k];
+		}
+		Line.Covered.resize(Last + 1);
+		Line.T_min = Line.Covered.front()[0];
+		Line.T_max = Line.Covered.back()[1];
+	}
+}
+
+void LineCorners(const vector<MergedLine> &merged, const double perpendicular_tresh, const double max_extension,
+				 vector<vector<LineCorner>> &corners, unordered_map<int64, Point2f> &pairs)
+{
+	const int Nb = int(merged.size());
+	corners.assign(Nb, vector<LineCorner>());
+	pairs.clear();
+	vector<Vec2f> Extent(Nb);
+	unordered_map<int64, vector<int>> Grid;
+	vector<Point> Cells;
+	unordered_set<int64> Tested;
+	for (int i = 0; i < Nb; ++i) {
+		const MergedLine &Line = merged[i];
+		const float Ext = float(max_extension) * (Line.T_max - Line.T_min);
+		Extent[i] = Vec2f(Line.T_min - Ext, Line.T_max + Ext);
+		GridCells(Line.Origin + Line.Dir * Extent[i][0], Line.Origin + Line.Dir * Extent[i][1], LINES_GRID_CELL, Cells);
+		for (const Point &C : Cells) Grid[CellKey(C.x, C.y)].push_back(i);
+	}
+
+	for (const auto &Cell : Grid) {
+		const vector<int> &Ids = Cell.second;
+		for (size_t m = 0; m < Ids.size(); ++m) {
+			for (size_t n = m + 1; n < Ids.size(); ++n) {
+				const int i = MIN(Ids[m], Ids[n]), j = MAX(Ids[m], Ids[n]);
+				// Two lines can share several cells, each pair is only intersected once
+				if (!Tested.insert(CellKey(i, j)).second) continue;
+				Point2f P;
+				if (fabs(AngleDiff(merged[i].Angle, merged[j].Angle) - CV_PI / 2) > perpendicular_tresh
+					|| !Intersection(merged[i], merged[j], P)) {
+					continue;
+				}
+				const float Ti = merged[i].Dir.dot(P - merged[i].Origin), Tj = merged[j].Dir.dot(P - merged[j].Origin);
+				if (Ti < Extent[i][0] || Ti > Extent[i][1] || Tj < Extent[j][0] || Tj > Extent[j][1]) continue;
+				corners[i].push_back({j, P});
+				corners[j].push_back({i, P});
+				pairs[CellKey(i, j)] = P;
+			}
+		}
+	}
+}
+
+bool GoodSide(const MergedLine &line, const Point2f &p0, const Point2f &p1, const double min_coverage)
+{
+	if (norm(p1 - p0) < LINES_MIN_SIDE) return false;
+	const float T0 = line.Dir.dot(p0 - line.Origin), T1 = line.Dir.dot(p1 - line.Origin),
+				T_lo = MIN(T0, T1), T_hi = MAX(T0, T1);
+	if (Coverage(line, T_lo - LINES_PAST_CORNER, T_lo) > 0.5f || Coverage(line, T_hi, T_hi + LINES_PAST_CORNER) > 0.5f) {
+		return false;
+	}
+	return Coverage(line, T_lo, T_hi) >= min_coverage;
+}
+
+void LinesToQuads(const vector<Vec4i> &lines, vector<Vec8i> &quads, const double angle_tresh, const double dist_tresh,
+				  const double perpendicular_tresh, const double min_coverage, const double max_extension)
+{
+	quads.clear();
+	if (lines.empty()) return;
+
+	// Step 1 Merging of the collinear segments
+	vector<MergedLine> Merged;
+	MergeSegments(lines, angle_tresh, dist_tresh, Merged);
+
+	// Step 2 Transformation of segments into lines
+	//			(to create intersections especially on segments not going to the corners of documents)
+	// Step 3 Locate the perpendicular intersection (with a threshold)
+	vector<vector<LineCorner>> Corners;
+	unordered_map<int64, Point2f> Pairs;
+	LineCorners(Merged, perpendicular_tresh, max_extension, Corners, Pairs);
+
+	// Step 4 find a document satisfying the following conditions: 4 lines forming a rectangle
+	//			(4 perpendicular corners and adjacent side not necessarily of the same size)
+	// Cycle a-b-c-d of lines, a is the smallest index and b < d so each rectangle is found once
+	vector<pair<double, Vec<float, 8>>> Candidates;
+	for (int a = 0; a < int(Merged.size()); ++a) {
+		for (const LineCorner &Ab : Corners[a]) {
+			for (const LineCorner &Ad : Corners[a]) {
+				const int b = Ab.Line, d = Ad.Line;
+				if (b <= a || d <= b) continue;
+				if (AngleDiff(Merged[b].Angle, Merged[d].Angle) > perpendicular_tresh) continue;
+				if (!GoodSide(Merged[a], Ad.Corner, Ab.Corner, min_coverage)) continue;
+				for (const LineCorner &Bc : Corners[b]) {
+					const int c = Bc.Line;
+					if (c <= a || c == d) continue;
+					if (AngleDiff(Merged[a].Angle, Merged[c].Angle) > perpendicular_tresh) continue;
+					if (!GoodSide(Merged[b], Ab.Corner, Bc.Corner, min_coverage)) continue;
+					const auto Cd = Pairs.find(CellKey(MIN(c, d), MAX(c, d)));
+					if (Cd == Pairs.end()) continue;
+					if (!GoodSide(Merged[c], Bc.Corner, Cd->second, min_coverage)
+						|| !GoodSide(Merged[d], Cd->second, Ad.Corner, min_coverage)) {
+						continue;
+					}
+					const Point2f Quad[4] = {Ab.Corner, Bc.Corner, Cd->second, Ad.Corner};
+					Candidates.emplace_back(contourArea(_InputArray(Quad, 4)), Vec<float, 8>(Quad[0].x, Quad[0].y, Quad[1].x,
+														Quad[1].y, Quad[2].x, Quad[2].y, Quad[3].x, Quad[3].y));
+				}
+			}
+		}
+	}
+
+	// Biggest documents first, the rectangles inside an accepted one are dropped
+	sort(Candidates.begin(), Candidates.end(),
+		 [](const pair<double, Vec<float, 8>> &x, const pair<double, Vec<float, 8>> &y) { return x.first > y.first; });
+	for (const auto &Candidate : Candidates) {
+		const Point2f *Quad = reinterpret_cast<const Point2f *>(Candidate.second.val);
+		const Point2f Center = (Quad[0] + Quad[1] + Quad[2] + Quad[3]) * 0.25f;
+		bool Inside = false;
+		for (const Vec8i &Doc : quads) {
+			if (pointPolygonTest(_InputArray(reinterpret_cast<const Point *>(Doc.val), 4), Center, false) >= 0) {
+				Inside = true;
+				break;
+			}
+		}
+		if (Inside) continue;
+		quads.emplace_back(cvRound(Quad[0].x), cvRound(Quad[0].y), cvRound(Quad[1].x), cvRound(Quad[1].y),
+						   cvRound(Quad[2].x), cvRound(Quad[2].y), cvRound(Quad[3].x), cvRound(Quad[3].y));
+	}
+}
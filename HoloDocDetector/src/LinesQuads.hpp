@@ -0,0 +1,34 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+//*******************************
+//********* Lines Quads *********
+//*******************************
+/// <summary>
+/// Documents from line segments (HoughLinesP), the edge based detection of the UWP DLL (see LinesToDocs).
+/// The collinear segments are merged into lines, the lines extended and intersected,
+/// and the documents are the cycles of 4 lines with 4 perpendicular corners.
+/// A side only needs to be partly covered by segments (document border partly occluded).
+/// A line going on through a corner (side of another document) doesn't make a corner.
+/// </summary>
+/// <param name="lines">Vector of segments \f$(x_1, y_1, x_2, y_2)\f$.</param>
+/// <param name="quads">The documents \f$(x_1, y_1, ..., x_4, y_4)\f$, corners in the order of the sides, biggest first.
+/// A quad inside a bigger one is dropped.</param>
+/// <param name="angle_tresh">Maximum angle between two collinear segments (radians).</param>
+/// <param name="dist_tresh">Maximum distance between two collinear segments (pixels).</param>
+/// <param name="perpendicular_tresh">Tolerance on the right angle of a corner and on parallel sides (radians).</param>
+/// <param name="min_coverage">Minimum ratio of each side covered by segments.</param>
+/// <param name="max_extension">Extension of the lines on each side to find the corners (ratio of their length),
+/// a side seen on min_coverage of its length reaches its corners if max_extension >= 1 / min_coverage - 1.</param>
+void LinesToQuads(const std::vector<cv::Vec4i> &lines, std::vector<cv::Vec8i> &quads, double angle_tresh = CV_PI / 90,
+				  double dist_tresh = 5, double perpendicular_tresh = CV_PI / 18, double min_coverage = 0.5,
+				  double max_extension = 1.0);
+
+/// <summary>
+/// Cells of a grid crossed by the segment [p0, p1] (grid traversal), from the cell of p0 to the cell of p1.
+/// A segment through the corner of 4 cells (up to float rounding) also gets the two cells beside the corner.
+/// </summary>
+/// <param name="cell">Side of the cells (pixels).</param>
+void GridCells(const cv::Point2f &p0, const cv::Point2f &p1, float cell, std::vector<cv::Point> &cells);
@@ -0,0 +1,138 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "DocDetector.hpp"
+#include "Rectifier.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+//*****************************
+//********* Rectifier *********
+Rectifier::Rectifier(const int side, const bool fixed, const int quantum, const int capacity)
+	: _Side(side), _Fixed(fixed), _Quantum(quantum), _Capacity(MAX(capacity, 1)), _Clock(0), _Hits(0)
+{
+}
+
+void Rectifier::SetOutput(const int side, const bool fixed)
+{
+	if (side == _Side && fixed == _Fixed) return;
+	_Side = side;
+	_Fixed = fixed;
+	Clear();
+}
+
+void Rectifier::Clear()
+{
+	_Entries.clear();
+	_Clock = 0;
+	_Hits = 0;
+}
+
+int Rectifier::Build(const Size &src_size, const Point quad[4], Entry &entry)
+{
+	//Max width and height of the quad
+	const Point Top = quad[1] - quad[0], Bottom = quad[2] - quad[3], Right = quad[2] - quad[1], Left = quad[3] - quad[0];
+	const double W = sqrt(double(MAX(Top.dot(Top), Bottom.dot(Bottom)))),
+				 H = sqrt(double(MAX(Right.dot(Right), Left.dot(Left))));
+	//Only Murphy can have this exception I can't reproduce him
+	if (W < 1 || H < 1) return INVALID_DOC;
+
+	double Scale = 1;
+	if (_Side > 0 && (_Fixed || MAX(W, H) > _Side)) Scale = _Side / MAX(W, H);
+	const Size Out(MAX(1, int(W * Scale)), MAX(1, int(H * Scale)));
+	const int Factor = Scale < 1 ? int(1 / Scale) : 1;
+
+	//Region of the quad (plus the bilinear neighbours), cut to a multiple of the factor
+	Rect Roi = boundingRect(_InputArray(quad, 4));
+	Roi.x -= Factor;
+	Roi.y -= Factor;
+	Roi.width += 2 * Factor;
+	Roi.height += 2 * Factor;
+	Roi &= Rect(Point(0, 0), src_size);
+	Roi.width -= Roi.width % Factor;
+	Roi.height -= Roi.height % Factor;
+	if (Roi.area() == 0) return INVALID_DOC;
+
+	//Output to region coordinates (the center of a pixel of the averaged region is the center of its block)
+	const float Out_w = float(W * Scale) - 1.0f, Out_h = float(H * Scale) - 1.0f;
+	const Point2f Out_corners[4] = {Point2f(0.0f, 0.0f), Point2f(Out_w, 0.0f), Point2f(Out_w, Out_h), Point2f(0.0f, Out_h)};
+	Point2f Corners[4];
+	for (int k = 0; k < 4; ++k) {
+		Corners[k] = Point2f((quad[k].x - Roi.x + 0.5f) / Factor - 0.5f, (quad[k].y - Roi.y + 0.5f) / Factor - 0.5f);
+	}
+	const Matx33d M = getPerspectiveTransform(Out_corners, Corners);
+
+	_Map_x.create(Out, CV_32FC1);
+	_Map_y.create(Out, CV_32FC1);
+	for (int v = 0; v < Out.height; ++v) {
+		float *Map_x = _Map_x.ptr<float>(v), *Map_y = _Map_y.ptr<float>(v);
+		double X = M(0, 1) * v + M(0, 2), Y = M(1, 1) * v + M(1, 2), Z = M(2, 1) * v + M(2, 2);
+		for (int u = 0; u < Out.width; ++u, X += M(0, 0), Y += M(1, 0), Z += M(2, 0)) {
+			const double Inv = Z != 0 ? 1 / Z : 0;
+			Map_x[u] = float(X * Inv);
+			Map_y[u] = float(Y * Inv);
+		}
+	}
+	convertMaps(_Map_x, _Map_y, entry.Map_xy, entry.Map_a, CV_16SC2);
+
+	for (int k = 0; k < 4; ++k) entry.Quad[k] = quad[k];
+	entry.Src_size = src_size;
+	entry.Roi = Roi;
+	entry.Factor = Factor;
+	return NO_ERRORS;
+}
+
+int Rectifier::Rectify(const Mat &src, const Point quad[4], Mat &dst)
+{
+	if (src.empty()) return EMPTY_MAT;
+
+	//Tables of the same quad (up to the quantum)
+	Entry *Found = nullptr;
+	for (Entry &E : _Entries) {
+		if (E.Src_size != src.size()) continue;
+		bool Still = true;
+		for (int k = 0; k < 4 && Still; ++k) {
+			Still = abs(E.Quad[k].x - quad[k].x) <= _Quantum && abs(E.Quad[k].y - quad[k].y) <= _Quantum;
+		}
+		if (Still) {
+			Found = &E;
+			break;
+		}
+	}
+	if (Found != nullptr) _Hits++;
+	else {
+		//New quad: a free entry or the least recently used one
+		if (int(_Entries.size()) < _Capacity) {
+			_Entries.emplace_back();
+			Found = &_Entries.back();
+		}
+		else {
+			Found = &*min_element(_Entries.begin(), _Entries.end(), [](const Entry &a, const Entry &b) {
+				return a.Last_use < b.Last_use;
+			});
+		}
+		const int ErrCode = Build(src.size(), quad, *Found);
+		if (ErrCode != NO_ERRORS) {
+			Found->Src_size = Size();
+			Found->Last_use = 0;
+			return ErrCode;
+		}
+	}
+	Found->Last_use = ++_Clock;
+
+	if (Found->Factor > 1) {
+		const Size Reduced(Found->Roi.width / Found->Factor, Found->Roi.height / Found->Factor);
+		resize(src(Found->Roi), _Reduced, Reduced, 0, 0, INTER_AREA);
+		remap(_Reduced, dst, Found->Map_xy, Found->Map_a, INTER_LINEAR);
+	}
+	else remap(src(Found->Roi), dst, Found->Map_xy, Found->Map_a, INTER_LINEAR);
+	return NO_ERRORS;
+}
+//*****************************
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+//*********************************
+//*********** Rectifier ***********
+//*********************************
+/// <summary>
+/// Perspective rectification of a document, its remap tables are kept from one frame to the next.
+/// The output has the size of the quad (longest opposite sides), bounded by a maximum side or scaled to it (canonical size).
+/// A document reduced by 2 or more is first averaged on blocks (INTER_AREA by an integer factor), so the remap doesn't alias.
+/// The fixed-point tables are reused while every corner stays within the quantum of the cached ones:
+/// a still document is only remapped.
+/// </summary>
+class Rectifier
+{
+public:
+	/// <param name="side">Longest side of the output (0: the quad size).</param>
+	/// <param name="fixed"><c>True</c>: every output has this longest side (canonical size), <c>False</c>: only a maximum.</param>
+	/// <param name="quantum">Corner motion (in pixels) under which the cached tables are reused.</param>
+	/// <param name="capacity">Number of quads cached (several documents).</param>
+	explicit Rectifier(int side = 0, bool fixed = false, int quantum = 2, int capacity = 4);
+
+	/// <summary>Change the output size (the cache is emptied if it changes).</summary>
+	void SetOutput(int side, bool fixed);
+
+	/// <summary>Remove the cached tables.</summary>
+	void Clear();
+
+	/// <summary>Rectify a document.</summary>
+	/// <param name="src">The image.</param>
+	/// <param name="quad">The corners: top left, top right, bottom right, bottom left.</param>
+	/// <param name="dst">The document.</param>
+	/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+	int Rectify(const cv::Mat &src, const cv::Point quad[4], cv::Mat &dst);
+
+	/// <summary>Number of rectifications with cached tables since the last Clear.</summary>
+	int Hits() const { return _Hits; }
+
+private:
+	/// <summary>Tables of one quad.</summary>
+	struct Entry
+	{
+		cv::Point Quad[4];		// Corners the tables were computed for
+		cv::Size Src_size;		// Empty if the entry is free
+		cv::Rect Roi;			// Region of the image read (multiple of Factor)
+		int Factor;				// Averaging factor of the region before the remap (1: none)
+		cv::Mat Map_xy, Map_a;	// Fixed-point tables (CV_16SC2 and CV_16UC1 of convertMaps)
+		unsigned Last_use;
+	};
+
+	int _Side;
+	bool _Fixed;
+	int _Quantum, _Capacity;
+	std::vector<Entry> _Entries;
+	unsigned _Clock;
+	int _Hits;
+	cv::Mat _Map_x, _Map_y;		// Float tables before the conversion
+	cv::Mat _Reduced;			// Region averaged by Factor
+
+	/// <summary>Compute the tables of a quad.</summary>
+	/// <return>Error Code (<see cref = "ERROR_CODE"/>).</return>
+	int Build(const cv::Size &src_size, const cv::Point quad[4], Entry &entry);
+};
@@ -0,0 +1,223 @@
+#ifdef _DLL_BUILD
+#include "stdafx.h"
+#endif
+#ifdef _DLL_UWP_BUILD
+#include "pch.h"
+#endif
+
+#include "ThreadPool.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//**********************************
+//********** DECLARATIONS **********
+//**********************************
+const int BANDS_BY_WORKER = 4,	// Bands by worker (a slow band can be stolen)
+		  BAND_ROWS_MIN = 32;	// Rows by band at least (the stages with a window recompute a few rows by band)
+
+/// <summary>Remaining items [Begin, End) of a worker.</summary>
+struct WorkRange
+{
+	mutex Mutex;
+	int Begin = 0, End = 0;
+
+	/// <summary>Take the first item (owner side).</summary>
+	bool Pop(int &item);
+
+	/// <summary>Take the second half of the items (thief side).</summary>
+	bool Split(int &begin, int &end);
+};
+
+/// <summary>
+/// Threads kept for the whole process, parked on a condition variable between the calls.
+/// One call at a time: the threads and the ranges only grow when a call needs more workers than the previous ones.
+/// </summary>
+class WorkerPool
+{
+public:
+	~WorkerPool();
+
+	/// <summary>The pool of the process.</summary>
+	static WorkerPool &Instance();
+
+	/// <summary>Run the items on nb_workers workers (the calling thread is the worker 0), <c>False</c> if the pool is busy.</summary>
+	bool Run(int nb_items, int nb_workers, FunctionRef<void(int, int)> body);
+
+private:
+	/// <summary>Loop of the thread of the worker, waits for the calls it takes part in.</summary>
+	void park(int worker);
+
+	mutex _Call;						// Held during a call
+	mutex _Mutex;						// Protects the fields of the call below
+	condition_variable _Wake, _Done;
+	vector<thread> _Threads;			// Workers 1 to _Threads.size()
+	unique_ptr<WorkRange[]> _Ranges;	// One by worker
+	int _Nb_ranges = 0;
+	uint64_t _Generation = 0;			// Incremented at each call
+	int _Nb_workers = 0, _Running = 0;	// Workers of the call, threads still working
+	FunctionRef<void(int, int)> *_Body = nullptr;
+	bool _Stop = false;
+};
+
+/// <summary>True on a thread running a body: a nested call runs on this thread only.</summary>
+static thread_local bool In_body = false;
+
+/// <summary>Worker loop: own items first then steal from the others.</summary>
+static void Work(int worker, WorkRange *ranges, int nb_workers, FunctionRef<void(int, int)> body);
+
+//*********************************
+//********** DEFINITIONS **********
+//*********************************
+bool WorkRange::Pop(int &item)
+{
+	lock_guard<mutex> Lock(Mutex);
+	if (Begin >= End) return false;
+	item = Begin++;
+	return true;
+}
+
+bool WorkRange::Split(int &begin, int &end)
+{
+	lock_guard<mutex> Lock(Mutex);
+	if (Begin >= End) return false;
+	begin = Begin + (End - Begin) / 2;
+	end = End;
+	End = begin;
+	return true;
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> Lock(_Mutex);
+		_Stop = true;
+	}
+	_Wake.notify_all();
+	for (thread &T : _Threads) T.join();
+}
+
+WorkerPool &WorkerPool::Instance()
+{
+	static WorkerPool Pool;
+	return Pool;
+}
+
+bool WorkerPool::Run(const int nb_items, const int nb_workers, FunctionRef<void(int, int)> body)
+{
+	unique_lock<mutex> Call(_Call, try_to_lock);
+	if (!Call.owns_lock()) return false;
+
+	//Grow once for the largest call
+	if (_Nb_ranges < nb_workers) {
+		_Ranges.reset(new WorkRange[nb_workers]);
+		_Nb_ranges = nb_workers;
+	}
+	while (int(_Threads.size()) < nb_workers - 1) {
+		_Threads.emplace_back(&WorkerPool::park, this, int(_Threads.size()) + 1);
+	}
+
+	//Even split at first
+	for (int w = 0; w < nb_workers; ++w) {
+		_Ranges[w].Begin = int(int64_t(nb_items) * w / nb_workers);
+		_Ranges[w].End = int(int64_t(nb_items) * (w + 1) / nb_workers);
+	}
+
+	{
+		lock_guard<mutex> Lock(_Mutex);
+		_Body = &body;
+		_Nb_workers = nb_workers;
+		_Running = nb_workers - 1;
+		_Generation++;
+	}
+	_Wake.notify_all();
+	In_body = true;
+	Work(0, _Ranges.get(), nb_workers, body);
+	In_body = false;
+
+	unique_lock<mutex> Lock(_Mutex);
+	_Done.wait(Lock, [this] { return _Running == 0; });
+	_Body = nullptr;
+	return true;
+}
+
+void WorkerPool::park(const int worker)
+{
+	In_body = true;
+	uint64_t Seen = 0;
+	unique_lock<mutex> Lock(_Mutex);
+	while (true) {
+		_Wake.wait(Lock, [&] { return _Stop || _Generation != Seen; });
+		if (_Stop) return;
+		Seen = _Generation;
+		if (worker >= _Nb_workers) continue;	// Not in this call
+
+		FunctionRef<void(int, int)> &Body = *_Body;
+		const int Nb_workers = _Nb_workers;
+		Lock.unlock();
+		Work(worker, _Ranges.get(), Nb_workers, Body);
+		Lock.lock();
+		if (--_Running == 0) _Done.notify_one();
+	}
+}
+
+void Work(const int worker, WorkRange *ranges, const int nb_workers, FunctionRef<void(int, int)> body)
+{
+	int Item;
+	while (true) {
+		while (ranges[worker].Pop(Item)) {
+			body(worker, Item);
+		}
+		//Steal from the next workers first (the neighbours are not all robbed by the same thief)
+		bool Stolen = false;
+		for (int k = 1; k < nb_workers && !Stolen; ++k) {
+			int Begin, End;
+			if (ranges[(worker + k) % nb_workers].Split(Begin, End)) {
+				lock_guard<mutex> Lock(ranges[worker].Mutex);
+				ranges[worker].Begin = Begin;
+				ranges[worker].End = End;
+				Stolen = true;
+			}
+		}
+		if (!Stolen) return;
+	}
+}
+
+int WorkersCount(const int nb_threads)
+{
+	if (nb_threads > 0) return nb_threads;
+	const int Nb_cores = int(thread::hardware_concurrency());
+	return Nb_cores > 0 ? Nb_cores : 1;
+}
+
+int ParallelFor(const int nb_items, const int nb_threads, FunctionRef<void(int, int)> body)
+{
+	if (nb_items <= 0) return 0;
+	int Nb_workers = WorkersCount(nb_threads);
+	if (Nb_workers > nb_items) Nb_workers = nb_items;
+	if (Nb_workers > 1 && !In_body && WorkerPool::Instance().Run(nb_items, Nb_workers, body)) return Nb_workers;
+
+	//One worker, nested call or busy pool: on the calling thread
+	for (int i = 0; i < nb_items; ++i) body(0, i);
+	return 1;
+}
+
+int BandsCount(const int nb_rows, const int nb_threads)
+{
+	const int Nb_workers = WorkersCount(nb_threads);
+	if (Nb_workers == 1 || nb_rows <= BAND_ROWS_MIN) return 1;
+	const int Nb_bands = Nb_workers * BANDS_BY_WORKER, Nb_max = nb_rows / BAND_ROWS_MIN;
+	return Nb_bands < Nb_max ? Nb_bands : Nb_max;
+}
+
+void ParallelBands(const int nb_rows, const int nb_bands, const int nb_threads, FunctionRef<void(int, int, int)> body)
+{
+	ParallelFor(nb_bands, nb_threads, [&](int, const int band) {
+		body(band, int(int64_t(nb_rows) * band / nb_bands), int(int64_t(nb_rows) * (band + 1) / nb_bands));
+	});
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+
+//*****************************
+//********** Threads **********
+//*****************************
+
+template <typename Signature>
+class FunctionRef;
+
+/// <summary>
+/// Reference to a callable without allocation (unlike std::function), for the bodies of ParallelFor and ParallelBands.
+/// The callable is not copied: it must outlive the reference (a lambda given in the call is fine).
+/// </summary>
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)>
+{
+public:
+	template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, FunctionRef>::value>::type>
+	FunctionRef(F &&f) :
+		_Callable((void *)std::addressof(f)),
+		_Call([](void *callable, Args... args) -> R { return (*(typename std::remove_reference<F>::type *)callable)(args...); }) {}
+
+	R operator()(Args... args) const { return _Call(_Callable, args...); }
+
+private:
+	void *_Callable;
+	R (*_Call)(void *, Args...);
+};
+
+/// <summary>
+/// Run body(worker, item) on every item with a work-stealing scheme:
+/// each worker starts with its own contiguous range and steals half of the remaining range of another one when it is done.
+/// The calling thread is the worker 0, the others are the threads of a pool kept for the whole process:
+/// they are created by the first call that needs them then wait on a condition variable between the calls (no allocation after).
+/// A call made from a body, or while another thread uses the pool, runs on the calling thread only.
+/// </summary>
+/// <param name="nb_items">Number of items.</param>
+/// <param name="nb_threads">Number of workers (0: one by core).</param>
+/// <param name="body">Work on one item, the worker index allows per-worker buffers.</param>
+/// <returns>Number of workers used.</returns>
+int ParallelFor(int nb_items, int nb_threads, FunctionRef<void(int, int)> body);
+
+/// <summary>Number of workers for a number of threads (0: one by core).</summary>
+int WorkersCount(int nb_threads);
+
+/// <summary>Number of horizontal bands for ParallelBands: a few by worker (for the work stealing), not too thin.</summary>
+/// <param name="nb_rows">Number of rows.</param>
+/// <param name="nb_threads">Number of workers (0: one by core).</param>
+int BandsCount(int nb_rows, int nb_threads);
+
+/// <summary>
+/// Run body(band, begin, end) on horizontal bands of rows [begin, end) covering [0, nb_rows),
+/// with ParallelFor on the bands (the bands are contiguous and in order, the band index allows per-band results).
+/// </summary>
+/// <param name="nb_rows">Number of rows.</param>
+/// <param name="nb_bands">Number of bands (<see cref = "BandsCount"/>).</param>
+/// <param name="nb_threads">Number of workers (0: one by core).</param>
+/// <param name="body">Work on one band.</param>
+void ParallelBands(int nb_rows, int nb_bands, int nb_threads, FunctionRef<void(int, int, int)> body);